@@ -5,17 +5,19 @@
 #include <bitset>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "usage: add_cnf number1 number2." << std::endl;
+    GenerationOptions options;
+    std::vector<std::string> args = parse_generation_options(argc, argv, options);
+    if (args.size() != 2) {
+        std::cout << "usage: add_cnf [options] number1 number2." << std::endl;
         return 1;
     }
     
-    std::string num1_str = argv[1];
-    std::string num2_str = argv[2];
+    std::string num1_str = args[0];
+    std::string num2_str = args[1];
     
     if (!std::regex_match(num1_str, std::regex("^\\d+$")) || 
         !std::regex_match(num2_str, std::regex("^\\d+$"))) {
-        std::cout << "usage: add_cnf number1 number2." << std::endl;
+        std::cout << "usage: add_cnf [options] number1 number2." << std::endl;
         return 1;
     }
     
@@ -43,40 +45,25 @@ int main(int argc, char* argv[]) {
     std::cout << "Expected sum: " << sum << " (bit width: " << result_len << ")" << std::endl;
     std::cout << "Using bit width: " << final_len << std::endl;
     
-    std::vector<std::string> conditions;
+    GenerationContext context(options);
+    ConstraintDag conditions(context);
 
     // Add_NBit.new("input1", "input2", "result", "overflow", final_len)
-    {
-        Add_NBit add_nbit("input1", "input2", "result", "overflow", final_len);
-        auto add_clauses = add_nbit.expand();
-        conditions.insert(conditions.end(), add_clauses.begin(), add_clauses.end());
-    }
+    conditions.add<Add_NBit>(context.sym("input1"), context.sym("input2"), context.sym("result"), context.sym("overflow"), final_len);
     
     // Input_Equals_Number.new("input1", num1, final_len)
-    {
-        Input_Equals_Number input1_constraint("input1", num1, final_len);
-        auto input1_clauses = input1_constraint.expand();
-        conditions.insert(conditions.end(), input1_clauses.begin(), input1_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("input1"), num1, final_len);
     
     // Input_Equals_Number.new("input2", num2, final_len)
-    {
-        Input_Equals_Number input2_constraint("input2", num2, final_len);
-        auto input2_clauses = input2_constraint.expand();
-        conditions.insert(conditions.end(), input2_clauses.begin(), input2_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("input2"), num2, final_len);
     
-    conditions.push_back("-<overflow> 0 ");
+    conditions.add<ClauseCondition>(Clause{-var(context.sym("overflow"))});
     
-    {
-        Input_Equals_Number one_constraint("One_NBit_" + Z(final_len), 1, final_len);
-        auto one_clauses = one_constraint.expand();
-        conditions.insert(conditions.end(), one_clauses.begin(), one_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("One_NBit")[final_len], 1, final_len);
     
-    conditions.push_back(" -<Zero_1Bit_" + Z(1) + "> 0 ");
+    conditions.add<ClauseCondition>(Clause{-var(context.sym("Zero_1Bit")[1])});
     
-    std::string filename = "add_" + std::to_string(num1) + "_" + std::to_string(num2) + ".cnf";
+    std::string filename = cnf_file_name("add_" + std::to_string(num1) + "_" + std::to_string(num2), options);
     generate_cnf(conditions, filename);
     
     std::cout << "CNF file generated: " << filename << std::endl;
@@ -0,0 +1,25 @@
+#include "core.hpp"
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && argc != 3) {
+        std::cout << "usage: bcnf_to_cnf input.bcnf [output.cnf]" << std::endl;
+        return 1;
+    }
+    std::string input = argv[1];
+    std::string output;
+    if (argc == 3) {
+        output = argv[2];
+    } else if (input.size() > 5 && input.compare(input.size() - 5, 5, ".bcnf") == 0) {
+        output = input.substr(0, input.size() - 5) + ".cnf";
+    } else {
+        output = input + ".cnf";
+    }
+    
+    if (!binary_cnf_to_dimacs(input, output)) {
+        return 1;
+    }
+    std::cout << "CNF file generated: " << output << std::endl;
+    return 0;
+}
@@ -4,10 +4,26 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
-#include <regex>
-#include <set>
-#include <map>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
 #include <functional>
+#include <cctype>
+#include <charconv>
+#include <atomic>
+#include <unordered_set>
 
 /**
  * Prime and Composite Number CNF Generator
@@ -41,561 +57,3676 @@ std::string Z(int i) {
     return oss.str();
 }
 
+/**
+ * Compares two variable names the way their "<name>" forms compare, so that the
+ * integer-literal path numbers variables exactly like the string path does
+ */
+static int compare_symbol_names(std::string_view a, std::string_view b) {
+    size_t common = std::min(a.size(), b.size());
+    int c = a.compare(0, common, b, 0, common);
+    if (c != 0) {
+        return c;
+    }
+    if (a.size() == b.size()) {
+        return 0;
+    }
+    unsigned char next_a = (a.size() > common) ? a[common] : '>';
+    unsigned char next_b = (b.size() > common) ? b[common] : '>';
+    return (next_a < next_b) ? -1 : 1;
+}
+
+/**
+ * Registry of CNF variables
+ * Names are stored as a tree of segments (root label, then index or label segments),
+ * so a gadget can address e.g. the i-th bit of its j-th accumulator without building
+ * a string. Ids are handed out in order of first mention; the human-readable names
+ * are only formatted when the "cv" lines are written
+ */
+static unsigned long long node_key(int parent, int segment) {
+    return (static_cast<unsigned long long>(static_cast<unsigned int>(parent)) << 32) |
+           static_cast<unsigned int>(segment);
+}
+
+static size_t node_hash(unsigned long long key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+}
+
+VariableRegistry::VariableRegistry() {
+    clear();
+}
+
+void VariableRegistry::clear() {
+    nodes.assign(1, Node{-1, 0, 0});
+    labels.clear();
+    label_ids.clear();
+    slot_keys.assign(1024, 0);
+    slot_nodes.assign(1024, 0);
+    var_nodes.clear();
+}
+
+void VariableRegistry::grow() {
+    std::vector<unsigned long long> old_keys;
+    std::vector<int> old_nodes;
+    old_keys.swap(slot_keys);
+    old_nodes.swap(slot_nodes);
+    slot_keys.assign(old_keys.size() * 2, 0);
+    slot_nodes.assign(old_nodes.size() * 2, 0);
+    const size_t mask = slot_keys.size() - 1;
+    for (size_t i = 0; i < old_keys.size(); ++i) {
+        if (old_nodes[i] == 0) {
+            continue;
+        }
+        size_t slot = node_hash(old_keys[i]) & mask;
+        while (slot_nodes[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slot_keys[slot] = old_keys[i];
+        slot_nodes[slot] = old_nodes[i];
+    }
+}
+
+int VariableRegistry::label(const std::string& text) {
+    auto it = label_ids.find(text);
+    if (it != label_ids.end()) {
+        return it->second;
+    }
+    int id = static_cast<int>(labels.size());
+    labels.push_back(text);
+    label_ids.emplace(text, id);
+    return id;
+}
+
+int VariableRegistry::child(int parent, int segment) {
+    const unsigned long long key = node_key(parent, segment);
+    const size_t mask = slot_keys.size() - 1;
+    size_t slot = node_hash(key) & mask;
+    while (slot_nodes[slot] != 0) {
+        if (slot_keys[slot] == key) {
+            return slot_nodes[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    int id = static_cast<int>(nodes.size());
+    nodes.push_back(Node{parent, segment, 0});
+    slot_keys[slot] = key;
+    slot_nodes[slot] = id;
+    if (nodes.size() * 2 > slot_keys.size()) {
+        grow();
+    }
+    return id;
+}
+
+Literal VariableRegistry::var(int node) {
+    if (nodes[node].var == 0) {
+        var_nodes.push_back(node);
+        nodes[node].var = static_cast<int>(var_nodes.size());
+    }
+    return nodes[node].var;
+}
+
+std::string VariableRegistry::name(int var) const {
+    std::vector<int> segments;
+    for (int node = var_nodes[var - 1]; node != 0; node = nodes[node].parent) {
+        segments.push_back(nodes[node].segment);
+    }
+    std::string result;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        if (it != segments.rbegin()) {
+            result += '_';
+        }
+        if (*it < 0) {
+            result += labels[-*it - 1];
+        } else {
+            char digits[10];
+            unsigned int value = static_cast<unsigned int>(*it);
+            for (int i = 9; i >= 0; --i) {
+                digits[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            result.append(digits, 10);
+        }
+    }
+    return result;
+}
+
+char VariableRegistry::initial(int var) const {
+    int node = var_nodes[var - 1];
+    while (nodes[node].parent != 0) {
+        node = nodes[node].parent;
+    }
+    return labels[-nodes[node].segment - 1][0];
+}
+
+/**
+ * Returns the node that groups a variable with the rest of its gadget instance: the first two
+ * segments of a gadget name (e.g. AddNBit_0000000003) or the root label of any other name
+ */
+int VariableRegistry::instance(int var) const {
+    int node = var_nodes[var - 1];
+    int below = 0;
+    while (nodes[node].parent != 0) {
+        below = node;
+        node = nodes[node].parent;
+    }
+    const bool gadget = std::isupper(static_cast<unsigned char>(labels[-nodes[node].segment - 1][0]));
+    return (gadget && below != 0 && nodes[below].segment >= 0) ? below : node;
+}
+
+int VariableRegistry::size() const {
+    return static_cast<int>(var_nodes.size());
+}
+
+/**
+ * Returns the used variables ordered as their "<name>" strings would sort
+ * The order is computed on the name tree: a node's own variable comes first, then its
+ * index children in numeric order (indices are fixed-width), then its label children.
+ * Label children are ordered by comparing the labels; if one label is a prefix of the
+ * other and the order cannot be decided from the tree alone, the names are formatted
+ * and sorted as strings instead
+ */
+std::vector<int> VariableRegistry::name_order(const std::vector<char>& used) const {
+    const int node_count = static_cast<int>(nodes.size());
+    std::vector<char> needed(node_count, 0);
+    std::vector<char> has_index_child(node_count, 0);
+    std::vector<char> has_label_child(node_count, 0);
+    for (int v = 1; v <= size(); ++v) {
+        if (!used[v]) {
+            continue;
+        }
+        for (int node = var_nodes[v - 1]; node != 0 && !needed[node]; node = nodes[node].parent) {
+            needed[node] = 1;
+            if (nodes[node].segment < 0) {
+                has_label_child[nodes[node].parent] = 1;
+            } else {
+                has_index_child[nodes[node].parent] = 1;
+            }
+        }
+    }
+    
+    // Children of each needed node, grouped by parent
+    std::vector<int> first(node_count + 1, 0);
+    for (int node = 1; node < node_count; ++node) {
+        if (needed[node]) {
+            ++first[nodes[node].parent + 1];
+        }
+    }
+    for (int node = 0; node < node_count; ++node) {
+        first[node + 1] += first[node];
+    }
+    std::vector<int> children(first[node_count]);
+    std::vector<int> fill(first.begin(), first.end() - 1);
+    for (int node = 1; node < node_count; ++node) {
+        if (needed[node]) {
+            children[fill[nodes[node].parent]++] = node;
+        }
+    }
+    
+    bool ambiguous = false;
+    auto label_of = [this](int node) -> const std::string& {
+        return labels[-nodes[node].segment - 1];
+    };
+    // Decides whether the subtree of `shorter` sorts before a sibling whose label extends its label
+    auto prefix_before = [&](int shorter, const std::string& longer) {
+        const std::string& text = label_of(shorter);
+        const char c = longer[text.size()];
+        int before = 0;
+        int after = 0;
+        auto vote = [&](bool is_before) { is_before ? ++before : ++after; };
+        if (nodes[shorter].var != 0 && used[nodes[shorter].var]) {
+            vote('>' < c);
+        }
+        if (has_index_child[shorter]) {
+            if (c != '_') {
+                vote('_' < c);
+            } else if (text.size() + 1 < longer.size() &&
+                       !std::isdigit(static_cast<unsigned char>(longer[text.size() + 1]))) {
+                vote(true);
+            } else {
+                ambiguous = true;
+            }
+        }
+        if (has_label_child[shorter]) {
+            if (c != '_') {
+                vote('_' < c);
+            } else {
+                ambiguous = true;
+            }
+        }
+        if (before != 0 && after != 0) {
+            ambiguous = true;
+        }
+        return before != 0;
+    };
+    auto sibling_less = [&](int a, int b) {
+        const int seg_a = nodes[a].segment;
+        const int seg_b = nodes[b].segment;
+        if (seg_a >= 0 && seg_b >= 0) {
+            return seg_a < seg_b;
+        }
+        if (seg_a >= 0 || seg_b >= 0) {
+            const std::string& text = label_of(seg_a < 0 ? a : b);
+            if (std::isdigit(static_cast<unsigned char>(text[0]))) {
+                ambiguous = true;
+            }
+            return seg_a >= 0;
+        }
+        const std::string& text_a = label_of(a);
+        const std::string& text_b = label_of(b);
+        const size_t common = std::min(text_a.size(), text_b.size());
+        const int c = text_a.compare(0, common, text_b, 0, common);
+        if (c != 0) {
+            return c < 0;
+        }
+        if (text_a.size() < text_b.size()) {
+            return prefix_before(a, text_b);
+        }
+        return !prefix_before(b, text_a);
+    };
+    for (int node = 0; node < node_count; ++node) {
+        if (first[node + 1] - first[node] > 1) {
+            std::sort(children.begin() + first[node], children.begin() + first[node + 1], sibling_less);
+        }
+    }
+    
+    std::vector<int> order;
+    if (!ambiguous) {
+        std::vector<int> stack = {0};
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            if (node != 0 && nodes[node].var != 0 && used[nodes[node].var]) {
+                order.push_back(nodes[node].var);
+            }
+            for (int i = first[node + 1] - 1; i >= first[node]; --i) {
+                stack.push_back(children[i]);
+            }
+        }
+        return order;
+    }
+    
+    std::vector<std::string> names(size() + 1);
+    for (int v = 1; v <= size(); ++v) {
+        if (used[v]) {
+            names[v] = name(v);
+            order.push_back(v);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&names](int a, int b) {
+        return compare_symbol_names(names[a], names[b]) < 0;
+    });
+    return order;
+}
+
+/**
+ * Appends every clause of another database with two block copies
+ * Offsets are rebased onto the end of this database's literal arena
+ */
+void ClauseDatabase::append(const ClauseDatabase& other) {
+    const size_t base = literals.size();
+    const size_t count = other.size();
+    if (count == 0) {
+        return;
+    }
+    Literal* target = literals.allocate(other.literal_count());
+    std::memcpy(target, other.literals.data(), other.literal_count() * sizeof(Literal));
+    size_t* bounds = offsets.allocate(count);
+    for (size_t i = 0; i < count; ++i) {
+        bounds[i] = base + other.offsets[i + 1];
+    }
+}
+
+/**
+ * Releases both arenas in a single step and leaves an empty database
+ */
+void ClauseDatabase::clear() {
+    literals.release();
+    offsets.release();
+    offsets.push_back(0);
+}
+
+void ClauseDatabase::expand(ClauseSink& out) const {
+    for (size_t i = 0; i < size(); ++i) {
+        out.add((*this)[i]);
+    }
+}
+
+void CountingSink::add(std::span<const Literal> clause) {
+    ++clauses;
+    literals += clause.size();
+    for (Literal literal : clause) {
+        max_var = std::max(max_var, std::abs(literal));
+    }
+}
+
+FileSink::FileSink(std::ostream& stream, const std::vector<int>* literal_map)
+    : stream(stream), literal_map(literal_map) {}
+
+/**
+ * Formats one clause into a stack buffer and hands it to the stream in a single write
+ * Literals are renumbered through literal_map when one was given
+ */
+void FileSink::add(std::span<const Literal> clause) {
+    char buffer[4096];
+    char* cursor = buffer;
+    char* const limit = buffer + sizeof(buffer) - 16;
+    for (Literal literal : clause) {
+        if (cursor >= limit) {
+            stream.write(buffer, cursor - buffer);
+            cursor = buffer;
+        }
+        if (literal_map != nullptr) {
+            literal = literal < 0 ? -(*literal_map)[-literal] : (*literal_map)[literal];
+        }
+        cursor = std::to_chars(cursor, limit + 16, literal).ptr;
+        *cursor++ = ' ';
+    }
+    *cursor++ = '0';
+    *cursor++ = '\n';
+    stream.write(buffer, cursor - buffer);
+}
+
+namespace {
+
+// Appends value as a LEB128 varint: 7 bits per byte, low bits first, high bit set on all but the last byte
+void append_varint(std::string& bytes, unsigned long long value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<char>(value));
+}
+
+}
+
+BinarySink::BinarySink(std::ostream& stream, const std::vector<int>* literal_map)
+    : stream(stream), literal_map(literal_map) {}
+
+void BinarySink::add(std::span<const Literal> clause) {
+    scratch.assign(clause.begin(), clause.end());
+    if (literal_map != nullptr) {
+        for (Literal& literal : scratch) {
+            literal = literal < 0 ? -(*literal_map)[-literal] : (*literal_map)[literal];
+        }
+    }
+    std::sort(scratch.begin(), scratch.end(), [](Literal a, Literal b) {
+        return std::abs(a) != std::abs(b) ? std::abs(a) < std::abs(b) : a < b;
+    });
+    bytes.clear();
+    append_varint(bytes, scratch.size());
+    unsigned long long previous = 0;
+    for (Literal literal : scratch) {
+        const unsigned long long variable = static_cast<unsigned long long>(std::abs(literal));
+        append_varint(bytes, ((variable - previous) << 1) | (literal < 0 ? 1 : 0));
+        previous = variable;
+    }
+    stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void HashingSink::mix(unsigned int word) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        state ^= (word >> shift) & 0xff;
+        state *= 1099511628211ULL;
+    }
+}
+
+void HashingSink::add(std::span<const Literal> clause) {
+    for (Literal literal : clause) {
+        if (literal_map != nullptr) {
+            literal = literal < 0 ? -(*literal_map)[-literal] : (*literal_map)[literal];
+        }
+        mix(static_cast<unsigned int>(literal));
+    }
+    mix(0);
+    ++clauses;
+}
+
+void HashingSink::add_name(std::string_view name, int id) {
+    for (char c : name) {
+        state ^= static_cast<unsigned char>(c);
+        state *= 1099511628211ULL;
+    }
+    mix(0);
+    mix(static_cast<unsigned int>(id));
+}
+
+PrefixLiteralSink::PrefixLiteralSink(Literal literal, ClauseSink& next)
+    : literal(literal), next(next) {
+    unsigned long long mixed = (next.scope() ^ static_cast<unsigned int>(literal)) * 0x9e3779b97f4a7c15ULL;
+    mixed ^= mixed >> 31;
+    guard = (mixed == 0) ? 1 : mixed;
+}
+
+void PrefixLiteralSink::add_scoped(std::span<const Literal> clause, unsigned long long scope) {
+    scratch.assign(1, literal);
+    scratch.insert(scratch.end(), clause.begin(), clause.end());
+    next.add_scoped(scratch, scope);
+}
+
+GenerationContext::GenerationContext(const GenerationOptions& options) : options(options) {}
+
+/**
+ * Hands out the counter index of one gadget type
+ * Indices are process-wide (one per type), the counters themselves live in each context
+ */
+size_t GenerationContext::allocate_counter_slot() {
+    static std::atomic<size_t> next_slot{0};
+    return next_slot++;
+}
+
+Sym GenerationContext::sym(const std::string& label) {
+    return Sym(&registry, registry.child(0, -(registry.label(label) + 1)));
+}
+
+/**
+ * Rewinds every gadget counter to a saved state
+ * Counters first used after the snapshot go back to 0
+ */
+void GenerationContext::restore_counters(const std::vector<int>& saved) {
+    for (size_t i = 0; i < counters.size(); ++i) {
+        counters[i] = i < saved.size() ? saved[i] : 0;
+    }
+}
+
+size_t GenerationContext::GateKeyHash::operator()(const GateKey& key) const {
+    unsigned long long state = 14695981039346656037ULL;
+    for (int word : key) {
+        state ^= static_cast<unsigned int>(word);
+        state *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(state ^ (state >> 29));
+}
+
+Literal GenerationContext::find_gate(const GateKey& key) const {
+    auto found = gates.find(key);
+    return (found == gates.end()) ? 0 : found->second;
+}
+
+void GenerationContext::record_gate(const GateKey& key, Literal output) {
+    gates.emplace(key, output);
+}
+
+Literal GenerationContext::find_previous_gate(const GateKey& key) const {
+    auto found = previous_gates.find(key);
+    return (found == previous_gates.end()) ? 0 : found->second;
+}
+
+void GenerationContext::clear_gates() {
+    previous_gates = std::move(gates);
+    gates.clear();
+}
+
+bool GenerationContext::fix(Literal literal) {
+    literal = representative(literal);
+    const size_t id = static_cast<size_t>(literal < 0 ? -literal : literal);
+    if (id >= constants.size()) {
+        constants.resize(id + 1, 0);
+    }
+    if (constants[id] != 0) {
+        return false;
+    }
+    constants[id] = (literal < 0) ? -1 : 1;
+    return true;
+}
+
+/**
+ * Union by size, so representative() stays logarithmic without path compression
+ * A value fixed on either class is kept on the merged one
+ */
+bool GenerationContext::alias(Literal a, Literal b) {
+    int root_a = representative(a);
+    int root_b = representative(b);
+    if (root_a == root_b) {
+        return false;
+    }
+    const size_t needed = static_cast<size_t>(std::max(root_a, root_b)) + 1;
+    while (alias_parent.size() < needed) {
+        alias_parent.push_back(static_cast<int>(alias_parent.size()));
+        alias_size.push_back(1);
+    }
+    if (alias_size[root_a] < alias_size[root_b]) {
+        std::swap(root_a, root_b);
+    }
+    alias_parent[root_b] = root_a;
+    alias_size[root_a] += alias_size[root_b];
+    if (static_cast<size_t>(root_b) < constants.size() && constants[root_b] != 0) {
+        fix(constants[root_b] > 0 ? root_a : -root_a);
+    }
+    ++alias_merges;
+    return true;
+}
+
+namespace {
+
+constexpr unsigned long long unseen_scope = ~0ULL;
+constexpr unsigned long long mixed_scope = ~0ULL - 1;
+
+}
+
+void GenerationContext::record_scope(Literal literal, unsigned long long scope) {
+    const size_t id = static_cast<size_t>(literal < 0 ? -literal : literal);
+    if (id >= scopes.size()) {
+        scopes.resize(id + 1, unseen_scope);
+    }
+    if (scopes[id] == unseen_scope) {
+        scopes[id] = scope;
+    } else if (scopes[id] != scope) {
+        scopes[id] = mixed_scope;
+    }
+}
+
+bool GenerationContext::finish_scope_pass() {
+    const bool changed = scopes != previous_scopes;
+    previous_scopes = std::move(scopes);
+    scopes.clear();
+    return changed;
+}
+
+bool GenerationContext::only_in_scope(Literal literal, unsigned long long scope) const {
+    const size_t id = static_cast<size_t>(literal < 0 ? -literal : literal);
+    return id < previous_scopes.size() && previous_scopes[id] == scope;
+}
+
+std::vector<std::string> parse_generation_options(int argc, char* argv[], GenerationOptions& options) {
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "--structural-hashing") {
+            options.structural_hashing = true;
+        } else if (argument == "--constant-propagation") {
+            options.constant_propagation = true;
+        } else if (argument == "--alias-equalities") {
+            options.alias_equalities = true;
+        } else if (argument == "--binary") {
+            options.binary = true;
+        } else if (argument == "--compress=gz" || argument == "--compress=xz") {
+            options.compression = argument.substr(11);
+        } else if (argument == "--symbol-map") {
+            options.symbol_map = true;
+        } else if (argument == "--user-symbols") {
+            options.user_symbols_only = true;
+        } else if (argument == "--numbering=name") {
+            options.numbering = VariableNumbering::Name;
+        } else if (argument == "--numbering=first-use") {
+            options.numbering = VariableNumbering::FirstUse;
+        } else if (argument == "--numbering=topological") {
+            options.numbering = VariableNumbering::Topological;
+        } else if (argument == "--numbering=instance") {
+            options.numbering = VariableNumbering::Instance;
+        } else if (argument == "--clause-order=emit") {
+            options.clause_order = ClauseOrder::Emit;
+        } else if (argument == "--clause-order=variables") {
+            options.clause_order = ClauseOrder::Variables;
+        } else if (argument == "--clause-order=canonical") {
+            options.clause_order = ClauseOrder::Canonical;
+        } else if (argument == "--verify-digest") {
+            options.verify_digest = true;
+        } else if (argument == "--multiplier=array") {
+            options.multiplier = MultiplierStrategy::Array;
+        } else if (argument == "--multiplier=wallace") {
+            options.multiplier = MultiplierStrategy::Wallace;
+        } else if (argument == "--multiplier=dadda") {
+            options.multiplier = MultiplierStrategy::Dadda;
+        } else if (argument == "--multiplier=karatsuba") {
+            options.multiplier = MultiplierStrategy::Karatsuba;
+        } else if (argument == "--symmetric-square") {
+            options.symmetric_square = true;
+        } else if (argument == "--adder=ripple") {
+            options.adder = AdderStrategy::Ripple;
+        } else if (argument == "--adder=kogge-stone") {
+            options.adder = AdderStrategy::KoggeStone;
+        } else if (argument == "--adder=brent-kung") {
+            options.adder = AdderStrategy::BrentKung;
+        } else if (argument == "--adder=sklansky") {
+            options.adder = AdderStrategy::Sklansky;
+        } else if (argument == "--increment-chain") {
+            options.increment_chain = true;
+        } else if (argument == "--modmul=divide") {
+            options.modmul = ModularMultiplication::Divide;
+        } else if (argument == "--modmul=interleaved") {
+            options.modmul = ModularMultiplication::Interleaved;
+        } else if (argument.rfind("--threads=", 0) == 0) {
+            options.threads = static_cast<unsigned>(std::strtoul(argument.c_str() + 10, nullptr, 10));
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    return arguments;
+}
+
+ConstraintDag::ConstraintDag(GenerationContext& context) : build(context) {}
+
+void ConstraintDag::add(std::shared_ptr<const ExpandableCondition> condition) {
+    roots.push_back(std::move(condition));
+}
+
+namespace {
+
+// Sink of the constant discovery passes: records the literal of every unguarded unit clause,
+// and with options.structural_hashing the guard scope of every variable
+class ConstantSink : public ClauseSink {
+private:
+    GenerationContext& context;
+public:
+    bool changed = false;
+    explicit ConstantSink(GenerationContext& context) : context(context) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        add_scoped(clause, 0);
+        if (clause.size() == 1 && context.fix(clause[0])) {
+            changed = true;
+        }
+    }
+    void add_scoped(std::span<const Literal> clause, unsigned long long scope) override {
+        if (context.options.structural_hashing) {
+            for (Literal literal : clause) {
+                context.record_scope(literal, scope);
+            }
+        }
+    }
+};
+
+}
+
+/**
+ * Expands every condition in order into out
+ * Conditions reached more than once are emitted only the first time, and the gadget counters
+ * are rewound to their state at the first expansion so later calls repeat the same names
+ *
+ * With options.constant_propagation, the first call runs discovery passes before emitting:
+ * the DAG is expanded into a ConstantSink, which records each unguarded unit clause in the
+ * context as soon as it is seen, until a pass finds no new fixed literal. Gadgets fold their
+ * gates over the recorded literals, so a pass can fix further outputs (e.g. a carry chain
+ * started by carry_out[0] == 0). The table is then frozen: every expansion emits the clauses of
+ * that last pass, and each fold only ever adds unit clauses as the table grows, so every
+ * recorded literal is still asserted by a unit clause of the emitted formula.
+ * options.alias_equalities and options.structural_hashing (which merges the output of a repeated
+ * unguarded gate into the first one) run the same passes until no new variables are merged
+ * either, so the hashing keys and folds of the emitting passes already see every alias.
+ */
+void ConstraintDag::expand(ClauseSink& out) const {
+    if (!expanded) {
+        start_counters = build.save_counters();
+        expanded = true;
+        if (build.options.constant_propagation || build.options.alias_equalities
+            || build.options.structural_hashing) {
+            build.clear_constants();
+            for (bool changed = true; changed;) {
+                const size_t merges = build.alias_count();
+                ConstantSink constants(build);
+                expand_roots(constants);
+                const bool scopes_changed = build.options.structural_hashing && build.finish_scope_pass();
+                changed = constants.changed || build.alias_count() != merges || scopes_changed;
+            }
+        }
+    }
+    expand_roots(out);
+}
+
+void ConstraintDag::expand_roots(ClauseSink& out) const {
+    build.restore_counters(start_counters);
+    build.clear_gates();
+    std::unordered_set<const ExpandableCondition*> seen;
+    for (const auto& condition : roots) {
+        if (seen.insert(condition.get()).second) {
+            condition->expand(out);
+        }
+    }
+}
+
+ClauseCondition::ClauseCondition(GenerationContext&, Clause clause) : clause(std::move(clause)) {}
+
+void ClauseCondition::expand(ClauseSink& out) const {
+    out.add(clause);
+}
+
+Sym::Sym(VariableRegistry* registry, int node) : registry(registry), node(node) {}
+
+Sym Sym::operator[](int index) const {
+    return Sym(registry, registry->child(node, index));
+}
+
+Sym Sym::operator[](const char* label) const {
+    return Sym(registry, registry->child(node, -(registry->label(label) + 1)));
+}
+
+Literal Sym::var() const {
+    return registry->var(node);
+}
+
+Literal var(const Sym& name) {
+    return name.var();
+}
+
+namespace {
+
+// Kind tags of structural hashing keys
+enum GateKind {
+    GATE_CARRY_OUT = 1,
+    GATE_XOR3,
+    GATE_AND,
+    GATE_OR,
+    GATE_EQUALS,
+    GATE_LESS_THAN,
+    GATE_IF_ELSE,
+    GATE_XOR,
+    GATE_GENERATE,
+    ASSERT_EQUALS_CONSTANT,
+    ASSERT_NOT_EQUALS_CONSTANT,
+    DEFINE_EQUALS_CONSTANT,
+    GUARDED_EQUALS_CONSTANT,
+    OR_CONDITION
+};
+
+// Structural key with the guard scope of out in words 1 and 2
+GenerationContext::GateKey scoped_key(int kind, unsigned long long scope) {
+    return {kind, static_cast<int>(scope >> 32), static_cast<int>(scope & 0xffffffffULL)};
+}
+
+/**
+ * Structural hashing of a comparison against a constant (options.structural_hashing)
+ * bits[i] is the literal that is true when bit i matches the constant; the comparison
+ * asserts all of them (equals) or at least one of their negations (not equals)
+ * Returns true when the comparison has been taken care of:
+ *  - an identical assertion was already made under this guard or unguarded, so nothing is added
+ *  - a multi-bit equality repeats under several guards: it is defined once, unguarded, by a
+ *    shared literal e (e -> bits) and only the unit clause {e} is added under each guard. The
+ *    first occurrence uses e too when the previous expansion found the repeat, so that every
+ *    occurrence adds the same clause (see Or_Condition)
+ * Returns false when the caller should emit its usual clauses (unguarded, a comparison made
+ * under a single guard, and not equals, whose one clause {e} could not shorten)
+ */
+bool share_comparison(GenerationContext& context, ClauseSink& out, bool equals, const Clause& bits) {
+    const unsigned long long scope = out.scope();
+    GenerationContext::GateKey key = scoped_key(equals ? ASSERT_EQUALS_CONSTANT : ASSERT_NOT_EQUALS_CONSTANT, scope);
+    for (Literal bit : bits) {
+        key.push_back(context.representative(bit));
+    }
+    if (context.find_gate(key) != 0) {
+        return true;
+    }
+    context.record_gate(key, 1);
+    if (scope != 0) {
+        GenerationContext::GateKey unguarded = key;
+        unguarded[1] = unguarded[2] = 0;
+        if (context.find_gate(unguarded) != 0) {
+            return true;
+        }
+    }
+    if (scope == 0 || !equals || bits.size() < 2) {
+        return false;
+    }
+    
+    GenerationContext::GateKey definition = key;
+    definition[0] = DEFINE_EQUALS_CONSTANT;
+    definition[1] = definition[2] = 0;
+    Literal shared = context.find_gate(definition);
+    if (shared == 0) {
+        GenerationContext::GateKey seen = definition;
+        seen[0] = GUARDED_EQUALS_CONSTANT;
+        if (context.find_gate(seen) == 0 && context.find_previous_gate(definition) == 0) {
+            context.record_gate(seen, 1);
+            return false;
+        }
+        shared = var(context.sym("Shared_Equals_Constant")[context.next_instance<Input_Equals_Number>()]);
+        ClauseSink& unguarded_out = out.root();
+        for (Literal bit : bits) {
+            unguarded_out.add({-shared, bit});
+        }
+        context.record_gate(definition, shared);
+    }
+    out.add({shared});
+    return true;
+}
+
+// Sink adaptor that forwards every clause and folds it, with its literals replaced by their
+// representatives, into a 64-bit digest of the clause stream
+class DigestSink : public ClauseSink {
+private:
+    const GenerationContext& context;
+    ClauseSink& next;
+    unsigned long long state = 14695981039346656037ULL;
+    void mix(std::span<const Literal> clause) {
+        for (Literal literal : clause) {
+            state = (state ^ static_cast<unsigned int>(context.representative(literal))) * 1099511628211ULL;
+        }
+        state = (state ^ 0) * 1099511628211ULL;
+    }
+public:
+    DigestSink(const GenerationContext& context, ClauseSink& next) : context(context), next(next) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        mix(clause);
+        next.add(clause);
+    }
+    void add_scoped(std::span<const Literal> clause, unsigned long long scope) override {
+        mix(clause);
+        next.add_scoped(clause, scope);
+    }
+    unsigned long long scope() const override { return next.scope(); }
+    ClauseSink& root() override { return next.root(); }
+    void define(Literal output, std::span<const Literal> inputs) override { next.define(output, inputs); }
+    unsigned long long digest() const { return state; }
+};
+
+}
+
 /**
  * Class to represent the condition: input == value
  * Generates CNF clauses that enforce input to be equal to a specific value
  * This is used to set constant values in the mathematical constraints
  * 
- * For each bit position, generates a literal that is true if the bit matches
- * the corresponding bit in the target value, false otherwise
+ * For each bit position, generates a literal that is true if the bit matches
+ * the corresponding bit in the target value, false otherwise
+ */
+Input_Equals_Number::Input_Equals_Number(GenerationContext& context, const Sym& input, int value, int n) 
+    : context(context), input(input), value(value), n(n) {}
+
+void Input_Equals_Number::expand(ClauseSink& out) const {
+    Clause bits(n);
+    for (int i = 0; i < n; ++i) {
+        Literal bit = var(input[i]);
+        if (((value >> i) & 1) == 1) {
+            bits[i] = bit;
+        } else {
+            bits[i] = -bit;
+        }
+    }
+    if (context.options.structural_hashing && share_comparison(context, out, true, bits)) {
+        return;
+    }
+    for (Literal bit : bits) {
+        out.add({bit});
+    }
+}
+
+/**
+ * Class to represent the condition: input != value
+ * Generates CNF clauses that enforce input to be different from a specific value
+ * This is used to exclude specific values from the solution space
+ * 
+ * Creates a single clause that is satisfied when at least one bit differs
+ * from the corresponding bit in the target value
+ */
+Input_Not_Equals_Number::Input_Not_Equals_Number(GenerationContext& context, const Sym& input, int value, int n) 
+    : context(context), input(input), value(value), n(n) {}
+
+void Input_Not_Equals_Number::expand(ClauseSink& out) const {
+    Clause clause(n);
+    for (int i = 0; i < n; ++i) {
+        Literal bit = var(input[i]);
+        if (((value >> i) & 1) == 1) {
+            clause[i] = -bit;
+        } else {
+            clause[i] = bit;
+        }
+    }
+    if (context.options.structural_hashing) {
+        Clause bits(n);
+        std::transform(clause.begin(), clause.end(), bits.begin(), [](Literal literal) { return -literal; });
+        if (share_comparison(context, out, false, bits)) {
+            return;
+        }
+    }
+    out.add(clause);
+}
+
+namespace {
+
+/**
+ * Compile-time clause templates for the 1-bit gates
+ * A gate is described by its truth table: bit r of table is the output for input row r,
+ * where input 0 is the most significant bit of r. gate_pattern() turns the table into CNF
+ * at compile time, one clause per row that forbids the wrong output for that row.
+ * Operands are numbered inputs first and output last; a pattern literal is +(k + 1) or
+ * -(k + 1) for operand k, and emitting a gate only substitutes the operand ids.
+ */
+struct GatePattern {
+    static constexpr int max_clauses = 8;
+    static constexpr int max_width = 4;
+    signed char literals[max_clauses][max_width] = {};
+    int width[max_clauses] = {};
+    int count = 0;
+    int inputs = 0;
+    unsigned table = 0;
+    bool symmetric = false;    // the output does not depend on the order of the inputs
+};
+
+enum class RowOrder { Ascending, Descending };
+
+template <typename Function>
+constexpr unsigned truth_table(int inputs, Function f) {
+    unsigned table = 0;
+    for (unsigned row = 0; row < (1u << inputs); ++row) {
+        if (f(row)) {
+            table |= 1u << row;
+        }
+    }
+    return table;
+}
+
+// Value of input k in row (input 0 is the most significant bit)
+constexpr unsigned row_input(unsigned row, int inputs, int k) {
+    return (row >> (inputs - 1 - k)) & 1;
+}
+
+/**
+ * Builds the clause pattern of a gate with the given truth table
+ * Rows are visited in the given order. With merge set, each row is first widened into the
+ * largest cube on which the output is constant, dropping inputs from the last one backwards,
+ * and rows already covered by an earlier cube are skipped
+ */
+constexpr GatePattern gate_pattern(int inputs, unsigned table, RowOrder order, bool merge = false) {
+    GatePattern pattern;
+    const unsigned rows = 1u << inputs;
+    pattern.inputs = inputs;
+    pattern.table = table;
+    pattern.symmetric = true;
+    for (unsigned row = 0; row < rows; ++row) {
+        for (int j = 0; j + 1 < inputs; ++j) {
+            const unsigned bit_j = 1u << (inputs - 1 - j), bit_k = 1u << (inputs - 2 - j);
+            unsigned swapped = row & ~(bit_j | bit_k);
+            swapped |= (row & bit_j) ? bit_k : 0;
+            swapped |= (row & bit_k) ? bit_j : 0;
+            if (((table >> row) & 1) != ((table >> swapped) & 1)) {
+                pattern.symmetric = false;
+            }
+        }
+    }
+    unsigned covered_masks[GatePattern::max_clauses] = {};
+    unsigned covered_rows[GatePattern::max_clauses] = {};
+    for (unsigned step = 0; step < rows; ++step) {
+        const unsigned row = (order == RowOrder::Ascending) ? step : rows - 1 - step;
+        const bool output = (table >> row) & 1;
+        bool covered = false;
+        for (int i = 0; i < pattern.count; ++i) {
+            covered = covered || ((row & covered_masks[i]) == covered_rows[i]);
+        }
+        if (covered) {
+            continue;
+        }
+        unsigned care = rows - 1;
+        if (merge) {
+            for (int k = inputs - 1; k >= 0; --k) {
+                const unsigned wider = care & ~(1u << (inputs - 1 - k));
+                bool constant = true;
+                for (unsigned other = 0; other < rows; ++other) {
+                    if ((other & wider) == (row & wider) && (((table >> other) & 1) != output)) {
+                        constant = false;
+                    }
+                }
+                if (constant) {
+                    care = wider;
+                }
+            }
+        }
+        int width = 0;
+        for (int k = 0; k < inputs; ++k) {
+            if ((care >> (inputs - 1 - k)) & 1) {
+                pattern.literals[pattern.count][width++] = static_cast<signed char>(row_input(row, inputs, k) ? -(k + 1) : (k + 1));
+            }
+        }
+        pattern.literals[pattern.count][width++] = static_cast<signed char>(output ? (inputs + 1) : -(inputs + 1));
+        pattern.width[pattern.count] = width;
+        covered_masks[pattern.count] = care;
+        covered_rows[pattern.count] = row & care;
+        ++pattern.count;
+    }
+    return pattern;
+}
+
+/**
+ * Structural hashing of a 1-bit gate (options.structural_hashing)
+ * Gates are keyed on kind, guard scope and input literals (sorted for symmetric gates). When an
+ * identical gate already exists under this guard or unguarded, its output is reused: the output
+ * variable is merged into the existing one (GenerationContext::alias, so both names get one
+ * DIMACS id and no clause is added) when the gate is unguarded, or when every clause with the
+ * output is added under this guard (the last expansion's scopes), so that the output is
+ * unconstrained whenever the guard is off; otherwise the two clauses output <-> existing output
+ * are added under the guard
+ * Returns false when the gate is new and its clauses must be emitted
+ */
+bool share_gate(GenerationContext& context, ClauseSink& out, const GatePattern& pattern, int kind,
+                const Literal* operands) {
+    const unsigned long long scope = out.scope();
+    GenerationContext::GateKey key = scoped_key(kind, scope);
+    for (int k = 0; k < pattern.inputs; ++k) {
+        key.push_back(context.representative(operands[k]));
+    }
+    if (pattern.symmetric) {
+        std::sort(key.begin() + 3, key.end());
+    }
+    const Literal output = operands[pattern.inputs];
+    Literal existing = context.find_gate(key);
+    if (existing == 0 && scope != 0) {
+        GenerationContext::GateKey unguarded = key;
+        unguarded[1] = unguarded[2] = 0;
+        existing = context.find_gate(unguarded);
+    }
+    if (existing == 0) {
+        context.record_gate(key, output);
+        return false;
+    }
+    if (context.representative(existing) == context.representative(output)) {
+        return true;
+    }
+    if (output > 0 && existing > 0 && (scope == 0 || context.only_in_scope(output, scope))) {
+        context.alias(existing, output);
+        return true;
+    }
+    out.add({-output, existing});
+    out.add({output, -existing});
+    return true;
+}
+
+// Emits a gate pattern with the operand ids substituted
+void emit_pattern(ClauseSink& out, const GatePattern& pattern, const Literal* operands) {
+    Literal clause[GatePattern::max_width];
+    for (int i = 0; i < pattern.count; ++i) {
+        for (int j = 0; j < pattern.width[i]; ++j) {
+            const int code = pattern.literals[i][j];
+            clause[j] = (code > 0) ? operands[code - 1] : -operands[-code - 1];
+        }
+        out.add(std::span<const Literal>(clause, pattern.width[i]));
+    }
+}
+
+/**
+ * Constant propagation of a 1-bit gate (options.constant_propagation)
+ * The known inputs are substituted into the truth table and the gate is rebuilt over the
+ * remaining ones: a constant output becomes a unit clause, a single remaining input an
+ * equivalence (or its negation), two remaining inputs the merged clauses of the smaller gate,
+ * e.g. a full adder with carry_in == 0 becomes a half adder
+ * Returns false when no input is known and the gate must be emitted as is
+ */
+bool fold_gate(GenerationContext& context, ClauseSink& out, const GatePattern& pattern, const Literal* operands) {
+    Literal remaining[GatePattern::max_width];
+    int positions[GatePattern::max_width];
+    int free_count = 0;
+    unsigned known_row = 0;
+    for (int k = 0; k < pattern.inputs; ++k) {
+        const int value = context.constant(operands[k]);
+        if (value == 0) {
+            positions[free_count] = pattern.inputs - 1 - k;
+            remaining[free_count++] = operands[k];
+        } else if (value > 0) {
+            known_row |= 1u << (pattern.inputs - 1 - k);
+        }
+    }
+    if (free_count == pattern.inputs) {
+        return false;
+    }
+    unsigned table = 0;
+    for (unsigned row = 0; row < (1u << free_count); ++row) {
+        unsigned full_row = known_row;
+        for (int k = 0; k < free_count; ++k) {
+            full_row |= row_input(row, free_count, k) << positions[k];
+        }
+        table |= ((pattern.table >> full_row) & 1) << row;
+    }
+    const Literal output = operands[pattern.inputs];
+    if (table == 0 || table == (1u << (1u << free_count)) - 1) {
+        out.add({table == 0 ? -output : output});
+        return true;
+    }
+    remaining[free_count] = output;
+    emit_pattern(out, gate_pattern(free_count, table, RowOrder::Descending, true), remaining);
+    return true;
+}
+
+// Emits a gate pattern, folded over known inputs or shared with an identical gate when enabled
+template <size_t Operands>
+void emit_gate(GenerationContext& context, ClauseSink& out, const GatePattern& pattern, int kind,
+               const Literal (&operands)[Operands]) {
+    static_assert(Operands <= GatePattern::max_width);
+    out.define(operands[pattern.inputs], std::span<const Literal>(operands, pattern.inputs));
+    if (context.options.constant_propagation && fold_gate(context, out, pattern, operands)) {
+        return;
+    }
+    if (context.options.structural_hashing && share_gate(context, out, pattern, kind, operands)) {
+        return;
+    }
+    emit_pattern(out, pattern, operands);
+}
+
+/**
+ * Variable aliasing of an equivalence a <-> b (options.alias_equalities)
+ * Unguarded, the two variables are merged into one (write_cnf gives both names the same id)
+ * and no clause is added; returns false under a guard, where the clauses are still needed
+ */
+bool alias_equivalence(GenerationContext& context, ClauseSink& out, Literal a, Literal b) {
+    if (!context.options.alias_equalities || out.scope() != 0) {
+        return false;
+    }
+    context.alias(a, b);
+    return true;
+}
+
+/**
+ * Constant propagation of an equivalence a <-> b (options.constant_propagation)
+ * Each side with a known value turns the other side into a unit clause
+ * Returns false when neither side is known
+ */
+bool fold_equivalence(GenerationContext& context, ClauseSink& out, Literal a, Literal b) {
+    const int value_a = context.constant(a);
+    const int value_b = context.constant(b);
+    if (value_a == 0 && value_b == 0) {
+        return false;
+    }
+    if (value_a != 0) {
+        out.add({value_a > 0 ? b : -b});
+    }
+    if (value_b != 0) {
+        out.add({value_b > 0 ? a : -a});
+    }
+    return true;
+}
+
+// carry_out == (in_a + in_b + carry_in >= 2)
+constexpr GatePattern carry_out_gate = gate_pattern(3, truth_table(3, [](unsigned row) {
+    return row_input(row, 3, 0) + row_input(row, 3, 1) + row_input(row, 3, 2) >= 2;
+}), RowOrder::Descending);
+
+// result == in_a ^ in_b ^ carry_in
+constexpr GatePattern xor3_gate = gate_pattern(3, truth_table(3, [](unsigned row) {
+    return (row_input(row, 3, 0) ^ row_input(row, 3, 1) ^ row_input(row, 3, 2)) == 1;
+}), RowOrder::Descending);
+
+// result == in_a & in_b
+constexpr GatePattern and_gate = gate_pattern(2, truth_table(2, [](unsigned row) {
+    return (row_input(row, 2, 0) & row_input(row, 2, 1)) == 1;
+}), RowOrder::Ascending);
+
+// result == in_a | in_b
+constexpr GatePattern or_gate = gate_pattern(2, truth_table(2, [](unsigned row) {
+    return (row_input(row, 2, 0) | row_input(row, 2, 1)) == 1;
+}), RowOrder::Descending);
+
+// result == (in_a == in_b)
+constexpr GatePattern equals_gate = gate_pattern(2, truth_table(2, [](unsigned row) {
+    return row_input(row, 2, 0) == row_input(row, 2, 1);
+}), RowOrder::Ascending);
+
+// result == (in_a < in_b)
+constexpr GatePattern less_than_gate = gate_pattern(2, truth_table(2, [](unsigned row) {
+    return row_input(row, 2, 0) < row_input(row, 2, 1);
+}), RowOrder::Ascending);
+
+// result == (cond ? in_a : in_b), operands ordered cond, in_a, in_b
+constexpr GatePattern if_else_gate = gate_pattern(3, truth_table(3, [](unsigned row) {
+    return (row_input(row, 3, 0) ? row_input(row, 3, 1) : row_input(row, 3, 2)) == 1;
+}), RowOrder::Descending, true);
+
+// result == in_a ^ in_b
+constexpr GatePattern xor_gate = gate_pattern(2, truth_table(2, [](unsigned row) {
+    return (row_input(row, 2, 0) ^ row_input(row, 2, 1)) == 1;
+}), RowOrder::Descending);
+
+// result == in_a | (in_b & in_c): the group generate of a prefix adder, operands ordered
+// generate, propagate, lower generate
+constexpr GatePattern generate_gate = gate_pattern(3, truth_table(3, [](unsigned row) {
+    return (row_input(row, 3, 0) | (row_input(row, 3, 1) & row_input(row, 3, 2))) == 1;
+}), RowOrder::Descending, true);
+
+static_assert(carry_out_gate.count == 8 && xor3_gate.count == 8 && xor_gate.count == 4);
+static_assert(generate_gate.count == 4 && !generate_gate.symmetric);
+static_assert(and_gate.count == 4 && or_gate.count == 4 && equals_gate.count == 4 && less_than_gate.count == 4);
+static_assert(if_else_gate.count == 4 && if_else_gate.width[0] == 3);
+static_assert(carry_out_gate.symmetric && xor3_gate.symmetric && and_gate.symmetric && or_gate.symmetric && equals_gate.symmetric);
+static_assert(!less_than_gate.symmetric && !if_else_gate.symmetric);
+
+}
+
+/**
+ * Class to represent carry-out logic for 1-bit addition
+ * carry_out == (popcount(in_a, in_b, carry_in) >= 2)
+ * This implements the carry generation logic for binary addition
+ * 
+ * The carry-out is 1 when at least 2 of the 3 inputs (a, b, carry_in) are 1
+ * This is equivalent to checking if the population count (number of 1s) is >= 2
+ */
+CarryOut_Equal_POPCNT_GREATER_THAN_2::CarryOut_Equal_POPCNT_GREATER_THAN_2(
+    GenerationContext& context,
+    const Sym& in_a, const Sym& in_b, 
+    const Sym& carry_in, const Sym& carry_out)
+    : context(context), in_a(in_a), in_b(in_b), carry_in(carry_in), carry_out(carry_out) {}
+
+void CarryOut_Equal_POPCNT_GREATER_THAN_2::expand(ClauseSink& out) const {
+    emit_gate(context, out, carry_out_gate, GATE_CARRY_OUT, {var(in_a), var(in_b), var(carry_in), var(carry_out)});
+}
+
+/**
+ * Class to represent result logic for 1-bit addition
+ * result == in_a XOR in_b XOR carry_in
+ * This implements the sum generation logic for binary addition
+ * 
+ * The result is 1 when an odd number of inputs (a, b, carry_in) are 1
+ * This is equivalent to the XOR of all three inputs
+ */
+Result_Equal_A_XOR_B_XOR_CarryIn::Result_Equal_A_XOR_B_XOR_CarryIn(
+    GenerationContext& context,
+    const Sym& in_a, const Sym& in_b, 
+    const Sym& carry_in, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), carry_in(carry_in), result(result) {}
+
+void Result_Equal_A_XOR_B_XOR_CarryIn::expand(ClauseSink& out) const {
+    emit_gate(context, out, xor3_gate, GATE_XOR3, {var(in_a), var(in_b), var(carry_in), var(result)});
+}
+
+/**
+ * Class to represent 1-bit addition: in_a + in_b + carry_in == (result, carry_out)
+ * Combines carry generation and sum generation logic into a complete 1-bit adder
+ * 
+ * This is the fundamental building block for multi-bit addition operations
+ * It generates all necessary CNF clauses to ensure correct addition behavior
+ */
+Add_1Bit::Add_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                   const Sym& carry_in, const Sym& result, const Sym& carry_out)
+    : context(context), in_a(in_a), in_b(in_b), carry_in(carry_in), result(result), carry_out(carry_out) {}
+
+void Add_1Bit::expand(ClauseSink& out) const {
+    
+    // Generate carry-out constraints
+    CarryOut_Equal_POPCNT_GREATER_THAN_2 carry_out_constraint(context, in_a, in_b, carry_in, carry_out);
+    carry_out_constraint.expand(out);
+
+    // Generate result constraints
+    Result_Equal_A_XOR_B_XOR_CarryIn result_constraint(context, in_a, in_b, carry_in, result);
+    result_constraint.expand(out);
+    
+}
+
+/**
+ * Class to represent N-bit addition: in_a + in_b == result
+ * Implements ripple-carry addition using multiple 1-bit adders
+ * 
+ * This creates a chain of 1-bit adders where the carry-out of each stage
+ * becomes the carry-in of the next stage, implementing standard binary addition
+ * With options.adder the carries come from a parallel-prefix network instead (PrefixAdder)
+ */
+Add_NBit::Add_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                   const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
+
+void Add_NBit::expand(ClauseSink& out) const {
+    
+    const int call_count = context.next_instance<Add_NBit>();
+    if (context.options.adder != AdderStrategy::Ripple) {
+        expand_prefix(out, call_count);
+        return;
+    }
+    const Sym carry_out = context.sym("AddNBit")[call_count]["carry_out"];
+    
+    // Initialize carry-in to 0 for the first bit
+    out.add({-var(carry_out[0])});
+    
+    // Chain 1-bit adders for each bit position
+    for (int i = 0; i < n; ++i) {
+        Add_1Bit add_1bit(
+            context,
+            in_a[i],
+            in_b[i],
+            carry_out[i],
+            result[i],
+            carry_out[i + 1]
+        );
+        add_1bit.expand(out);
+    }
+    
+    // Connect overflow to the final carry-out
+    const Literal carry = var(carry_out[n]);
+    const Literal over = var(over_flow);
+    if (alias_equivalence(context, out, over, carry)) {
+        return;
+    }
+    if (context.options.constant_propagation && fold_equivalence(context, out, over, carry)) {
+        return;
+    }
+    out.add({-over,  carry});
+    out.add({ over, -carry});
+    
+}
+
+namespace {
+
+/**
+ * Half-adder chain for in_a + 1 (or in_a - 1): the carry into bit 0 is the constant 1, so
+ * result_0 == !in_a_0 and carry_1 == in_a_0 (!in_a_0 when decrementing) need no gates, and every
+ * further bit is one XOR and one AND with the carry; over_flow is the final carry (borrow)
+ */
+void expand_increment_chain(GenerationContext& context, ClauseSink& out, const Sym& in_a, const Sym& result,
+                            const Sym& over_flow, const Sym& carry_out, int n, bool decrement) {
+    Literal carry = 0;
+    for (int i = 0; i < n; ++i) {
+        const Literal a = var(in_a[i]);
+        const Literal r = var(result[i]);
+        const Literal next = decrement ? -a : a;
+        if (i == 0) {
+            out.add({-r, -a});
+            out.add({ r,  a});
+            carry = next;
+            continue;
+        }
+        emit_gate(context, out, xor_gate, GATE_XOR, {a, carry, r});
+        const Literal carry_next = var(carry_out[i + 1]);
+        emit_gate(context, out, and_gate, GATE_AND, {next, carry, carry_next});
+        carry = carry_next;
+    }
+    
+    // Connect overflow to the final carry-out
+    const Literal over = var(over_flow);
+    if (n == 0) {
+        out.add({over});
+        return;
+    }
+    // Only variables can be aliased, and the 1-bit borrow is the negated !in_a_0
+    if (carry > 0 && alias_equivalence(context, out, over, carry)) {
+        return;
+    }
+    if (context.options.constant_propagation && fold_equivalence(context, out, over, carry)) {
+        return;
+    }
+    out.add({-over,  carry});
+    out.add({ over, -carry});
+}
+
+}
+
+/**
+ * Class to represent N-bit increment: in_a + 1 == result
+ * By default this is Add_NBit(in_a, One_NBit_<n>), the clauses of the Ruby generator, and
+ * One_NBit_<n> must be fixed to 1 by the caller; with options.increment_chain it is a
+ * half-adder chain with no second operand
+ */
+Inc_NBit::Inc_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), result(result), over_flow(over_flow), n(n) {}
+
+void Inc_NBit::expand(ClauseSink& out) const {
+    if (!context.options.increment_chain) {
+        Add_NBit(context, in_a, context.sym("One_NBit")[n], result, over_flow, n).expand(out);
+        return;
+    }
+    const int call_count = context.next_instance<Inc_NBit>();
+    expand_increment_chain(context, out, in_a, result, over_flow, context.sym("Inc_NBit")[call_count]["carry"], n, false);
+}
+
+/**
+ * Class to represent N-bit decrement: in_a - 1 == result
+ * By default this is Add_NBit(result, One_NBit_<n>) == in_a, whose overflow is set exactly when
+ * in_a == 0; with options.increment_chain it is a half-subtractor (borrow) chain over in_a
+ */
+Dec_NBit::Dec_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), result(result), over_flow(over_flow), n(n) {}
+
+void Dec_NBit::expand(ClauseSink& out) const {
+    if (!context.options.increment_chain) {
+        Add_NBit(context, result, context.sym("One_NBit")[n], in_a, over_flow, n).expand(out);
+        return;
+    }
+    const int call_count = context.next_instance<Dec_NBit>();
+    expand_increment_chain(context, out, in_a, result, over_flow, context.sym("Dec_NBit")[call_count]["carry"], n, true);
+}
+
+/**
+ * Class to represent multiplication with shift: (in_a * in_b) << shift == result
+ * Implements multiplication of N-bit number by 1-bit with left shift
+ * 
+ * This is a building block for full multiplication, implementing the partial product
+ * generation step where each bit of the multiplier is ANDed with the multiplicand
+ * and shifted to the appropriate position
+ */
+Mul_NBit_1Bit_Shift::Mul_NBit_1Bit_Shift(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                                         const Sym& result, int shift, int n)
+    : context(context), in_a(in_a), in_b(in_b), result(result), shift(shift), n(n) {}
+
+void Mul_NBit_1Bit_Shift::expand(ClauseSink& out) const {
+    
+    // Set lower bits to 0 (shift effect)
+    for (int i = 0; i < shift; ++i) {
+        out.add({-var(result[i])});
+    }
+    
+    // For each bit position, implement AND logic with shift
+    const Literal b = var(in_b);
+    for (int i = 0; i < n; ++i) {
+        // result[i+shift] = in_a[i] AND in_b
+        const Literal r = var(result[i + shift]);
+        const Literal a = var(in_a[i]);
+        const Literal operands[] = {a, b, r};
+        if (context.options.constant_propagation && fold_gate(context, out, and_gate, operands)) {
+            continue;
+        }
+        out.add({ r, -a, -b});
+        out.add({-r, -a,  b});
+        out.add({-r,  a, -b});
+        out.add({-r,  a,  b});
+    }
+    
+    // Set upper bits beyond result range to 0
+    for (int i = shift + n; i < n * 2; ++i) {
+        out.add({-var(result[i])});
+    }
+    
+}
+
+namespace {
+
+/**
+ * Gate-level builder over literals for the arithmetic circuits below; 0 stands for a constant
+ * false bit and the one-output helpers fold it away. Gate outputs are named <names>_pp_<k>
+ * (AND), <names>_fa_<k> / <names>_ha_<k> (adders) and <names>_gate_<k> (other gates)
+ */
+class BitCircuit {
+public:
+    using Bits = std::vector<Literal>;
+protected:
+    GenerationContext& context;
+    ClauseSink& out;
+    Sym names;
+    int products = 0;
+    int adders = 0;
+    int gates = 0;
+    
+    template <size_t Operands>
+    Literal gate(const GatePattern& pattern, int kind, const Literal (&inputs)[Operands - 1]) {
+        const Literal result = var(names["gate"][gates++]);
+        Literal operands[Operands];
+        std::copy(std::begin(inputs), std::end(inputs), operands);
+        operands[Operands - 1] = result;
+        emit_gate(context, out, pattern, kind, operands);
+        return result;
+    }
+public:
+    BitCircuit(GenerationContext& context, ClauseSink& out, const Sym& names)
+        : context(context), out(out), names(names) {}
+    
+    Literal and_bit(Literal a, Literal b) {
+        if (a == 0 || b == 0) {
+            return 0;
+        }
+        const Literal result = var(names["pp"][products++]);
+        emit_gate(context, out, and_gate, GATE_AND, {a, b, result});
+        return result;
+    }
+    Literal or_bit(Literal a, Literal b) {
+        if (a == 0 || b == 0) {
+            return a == 0 ? b : a;
+        }
+        return gate<3>(or_gate, GATE_OR, {a, b});
+    }
+    Literal xor_bit(Literal a, Literal b) {
+        if (a == 0 || b == 0) {
+            return a == 0 ? b : a;
+        }
+        return gate<3>(xor_gate, GATE_XOR, {a, b});
+    }
+    // g | (p & g_low), the generate of two adjacent prefix groups
+    Literal generate_bit(Literal g, Literal p, Literal g_low) {
+        if (p == 0 || g_low == 0) {
+            return g;
+        }
+        if (g == 0) {
+            return and_bit(p, g_low);
+        }
+        return gate<4>(generate_gate, GATE_GENERATE, {g, p, g_low});
+    }
+    // cond ? a : b
+    Literal mux_bit(Literal cond, Literal a, Literal b) {
+        if (a == b) {
+            return a;
+        }
+        if (a == 0) {
+            return and_bit(-cond, b);
+        }
+        if (b == 0) {
+            return and_bit(cond, a);
+        }
+        return gate<4>(if_else_gate, GATE_IF_ELSE, {cond, a, b});
+    }
+    void full_adder(Literal a, Literal b, Literal c, Bits& sums, Bits& carries) {
+        const Sym adder = names["fa"][adders++];
+        const Literal sum = var(adder["sum"]);
+        const Literal carry = var(adder["carry"]);
+        emit_gate(context, out, carry_out_gate, GATE_CARRY_OUT, {a, b, c, carry});
+        emit_gate(context, out, xor3_gate, GATE_XOR3, {a, b, c, sum});
+        sums.push_back(sum);
+        carries.push_back(carry);
+    }
+    void half_adder(Literal a, Literal b, Bits& sums, Bits& carries) {
+        const Sym adder = names["ha"][adders++];
+        const Literal sum = var(adder["sum"]);
+        const Literal carry = var(adder["carry"]);
+        emit_gate(context, out, and_gate, GATE_AND, {a, b, carry});
+        emit_gate(context, out, xor_gate, GATE_XOR, {a, b, sum});
+        sums.push_back(sum);
+        carries.push_back(carry);
+    }
+    // Adds up to three bits of one column (0 bits are skipped): the sum bit, or 0, and at most one carry
+    Literal add_column(Bits bits, Bits& carries) {
+        bits.erase(std::remove(bits.begin(), bits.end(), 0), bits.end());
+        Bits sums;
+        if (bits.size() == 3) {
+            full_adder(bits[0], bits[1], bits[2], sums, carries);
+        } else if (bits.size() == 2) {
+            half_adder(bits[0], bits[1], sums, carries);
+        } else {
+            sums = bits;
+        }
+        return sums.empty() ? 0 : sums[0];
+    }
+    // Ripple-carry sum of x and y, max(x.size(), y.size()) + 1 bits
+    Bits add(const Bits& x, const Bits& y) {
+        const size_t width = std::max(x.size(), y.size());
+        Bits result;
+        Bits carry;
+        for (size_t c = 0; c <= width; ++c) {
+            Bits bits = carry;
+            carry.clear();
+            bits.push_back(c < x.size() ? x[c] : 0);
+            bits.push_back(c < y.size() ? y[c] : 0);
+            result.push_back(add_column(bits, carry));
+        }
+        return result;
+    }
+    // Literal x == y, where y == 0 means constant false
+    void equate(Literal x, Literal y) {
+        if (y == 0) {
+            out.add({-x});
+            return;
+        }
+        if (context.options.constant_propagation && fold_equivalence(context, out, x, y)) {
+            return;
+        }
+        out.add({-x,  y});
+        out.add({ x, -y});
+    }
+};
+
+/**
+ * Multiplier circuits on a bit heap (options.multiplier other than Array)
+ * Column c of a heap holds literals of weight 2^c. sum() adds the heap up: full adders (and, in
+ * a Wallace tree, half adders on leftover pairs) reduce every column to at most two bits, then a
+ * ripple pass gives one literal per column, 0 standing for a constant false column. Variables are
+ * named Mul_NBit_Tree_<instance>_<kind>_<k> with one running k per kind
+ */
+class BitHeapMultiplier : public BitCircuit {
+public:
+    using Heap = std::vector<Bits>;
+private:
+    static constexpr size_t karatsuba_threshold = 16;
+    static_assert(karatsuba_threshold >= 4, "the (n - n / 2 + 1)-bit half sums must be narrower than n");
+    MultiplierStrategy strategy;
+    int middles = 0;
+    
+    static size_t height(const Heap& heap) {
+        size_t tallest = 0;
+        for (const Bits& column : heap) {
+            tallest = std::max(tallest, column.size());
+        }
+        return tallest;
+    }
+    
+    // One Wallace stage: every column is cut into full adders on triples and a half adder on a leftover pair
+    Heap wallace_stage(const Heap& heap) {
+        Heap next(heap.size() + 1);
+        for (size_t c = 0; c < heap.size(); ++c) {
+            const Bits& bits = heap[c];
+            size_t i = 0;
+            for (; i + 3 <= bits.size(); i += 3) {
+                full_adder(bits[i], bits[i + 1], bits[i + 2], next[c], next[c + 1]);
+            }
+            if (i + 2 == bits.size()) {
+                half_adder(bits[i], bits[i + 1], next[c], next[c + 1]);
+            } else if (i + 1 == bits.size()) {
+                next[c].push_back(bits[i]);
+            }
+        }
+        return next;
+    }
+    
+    // One Dadda stage: each column, counting the carries it receives, is brought down to target
+    Heap dadda_stage(const Heap& heap, size_t target) {
+        Heap next(heap.size() + 1);
+        for (size_t c = 0; c < heap.size(); ++c) {
+            const Bits& bits = heap[c];
+            size_t i = 0;
+            size_t column_height = bits.size() + next[c].size();
+            while (column_height > target && i + 2 <= bits.size()) {
+                if (column_height == target + 1 || i + 3 > bits.size()) {
+                    half_adder(bits[i], bits[i + 1], next[c], next[c + 1]);
+                    i += 2;
+                    column_height -= 1;
+                } else {
+                    full_adder(bits[i], bits[i + 1], bits[i + 2], next[c], next[c + 1]);
+                    i += 3;
+                    column_height -= 2;
+                }
+            }
+            next[c].insert(next[c].end(), bits.begin() + static_cast<std::ptrdiff_t>(i), bits.end());
+        }
+        return next;
+    }
+    
+public:
+    BitHeapMultiplier(GenerationContext& context, ClauseSink& out, const Sym& names, MultiplierStrategy strategy)
+        : BitCircuit(context, out, names), strategy(strategy) {}
+    
+    // Adds bits into heap at column shift, skipping constant false (0) bits
+    static void place(Heap& heap, const Bits& bits, size_t shift) {
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (bits[i] == 0) {
+                continue;
+            }
+            if (heap.size() <= shift + i) {
+                heap.resize(shift + i + 1);
+            }
+            heap[shift + i].push_back(bits[i]);
+        }
+    }
+    
+    // Adds the heap up; returns one literal per column (0 = constant false), carries included
+    Bits sum(Heap heap) {
+        if (strategy == MultiplierStrategy::Wallace) {
+            while (height(heap) > 2) {
+                heap = wallace_stage(heap);
+            }
+        } else {
+            // Dadda heights 2, 3, 4, 6, 9, 13, ...: each stage targets the largest one below the current height
+            std::vector<size_t> targets{2};
+            while (targets.back() < height(heap)) {
+                targets.push_back(targets.back() * 3 / 2);
+            }
+            targets.pop_back();
+            for (auto it = targets.rbegin(); it != targets.rend(); ++it) {
+                heap = dadda_stage(heap, *it);
+            }
+        }
+        Bits result;
+        Bits carry;
+        for (size_t c = 0; c < heap.size() || !carry.empty(); ++c) {
+            Bits bits = c < heap.size() ? heap[c] : Bits();
+            bits.insert(bits.end(), carry.begin(), carry.end());
+            carry.clear();
+            result.push_back(add_column(bits, carry));
+        }
+        return result;
+    }
+    
+    /**
+     * Product bits of a and b (a.size() + b.size() of them)
+     * Karatsuba, while both operands have at least karatsuba_threshold bits, splits them at
+     * h = n / 2 into a1 * 2^h + a0 and b1 * 2^h + b0 and multiplies z0 = a0 * b0, z2 = a1 * b1 and
+     * z1 = (a0 + a1) * (b0 + b1); the middle term m gets fresh variables tied by z0 + z2 + m == z1,
+     * and the product is z0 + m * 2^h + z2 * 2^2h
+     */
+    Bits multiply(const Bits& a, const Bits& b) {
+        const size_t width = a.size() + b.size();
+        Heap heap;
+        if (strategy == MultiplierStrategy::Karatsuba && a.size() == b.size() && a.size() >= karatsuba_threshold) {
+            const size_t n = a.size();
+            const size_t h = n / 2;
+            const Bits a0(a.begin(), a.begin() + static_cast<std::ptrdiff_t>(h));
+            const Bits a1(a.begin() + static_cast<std::ptrdiff_t>(h), a.end());
+            const Bits b0(b.begin(), b.begin() + static_cast<std::ptrdiff_t>(h));
+            const Bits b1(b.begin() + static_cast<std::ptrdiff_t>(h), b.end());
+            const Bits z0 = multiply(a0, b0);
+            const Bits z2 = multiply(a1, b1);
+            Heap sum_a, sum_b;
+            place(sum_a, a0, 0);
+            place(sum_a, a1, 0);
+            place(sum_b, b0, 0);
+            place(sum_b, b1, 0);
+            Bits a01 = sum(std::move(sum_a));
+            Bits b01 = sum(std::move(sum_b));
+            a01.resize(n - h + 1, 0);
+            b01.resize(n - h + 1, 0);
+            const Bits z1 = multiply(a01, b01);
+            
+            // m = a0 * b1 + a1 * b0 < 2^(n + 1)
+            Bits middle(n + 1);
+            const Sym middle_names = names["middle"][middles++];
+            for (size_t i = 0; i <= n; ++i) {
+                middle[i] = var(middle_names[static_cast<int>(i)]);
+            }
+            Heap check;
+            place(check, z0, 0);
+            place(check, z2, 0);
+            place(check, middle, 0);
+            const Bits total = sum(std::move(check));
+            for (size_t c = 0; c < std::max(total.size(), z1.size()); ++c) {
+                const Literal left = c < total.size() ? total[c] : 0;
+                const Literal right = c < z1.size() ? z1[c] : 0;
+                if (left != 0) {
+                    equate(left, right);
+                } else if (right != 0) {
+                    out.add({-right});
+                }
+            }
+            
+            place(heap, z0, 0);
+            place(heap, middle, h);
+            place(heap, z2, 2 * h);
+        } else {
+            for (size_t i = 0; i < b.size(); ++i) {
+                for (size_t j = 0; j < a.size(); ++j) {
+                    if (a[j] != 0 && b[i] != 0) {
+                        place(heap, {and_bit(a[j], b[i])}, i + j);
+                    }
+                }
+            }
+        }
+        return sum_to_width(std::move(heap), width);
+    }
+    
+    /**
+     * Bits of a * a (2 * a.size() of them)
+     * The partial products are symmetric: a_i * a_j for i < j appears twice and is placed once
+     * one column up, and a_i * a_i == a_i goes on the diagonal without a gate, so the heap holds
+     * n (n - 1) / 2 AND gates instead of n^2
+     */
+    Bits square(const Bits& a) {
+        Heap heap;
+        for (size_t i = 0; i < a.size(); ++i) {
+            place(heap, {a[i]}, 2 * i);
+            for (size_t j = i + 1; j < a.size(); ++j) {
+                if (a[i] != 0 && a[j] != 0) {
+                    place(heap, {and_bit(a[i], a[j])}, i + j + 1);
+                }
+            }
+        }
+        return sum_to_width(std::move(heap), 2 * a.size());
+    }
+    
+private:
+    // sum() of a heap whose value is known to fit in width bits; the columns past it can only be false
+    Bits sum_to_width(Heap heap, size_t width) {
+        Bits total = sum(std::move(heap));
+        for (size_t c = width; c < total.size(); ++c) {
+            if (total[c] != 0) {
+                out.add({-total[c]});
+            }
+        }
+        total.resize(width, 0);
+        return total;
+    }
+};
+
+/**
+ * Interleaved modular multiplication (ModMul_NBit): the multiplier bits are consumed MSB first and
+ * the running remainder r < m is kept at n bits, r = reduce(reduce(2r) + b_i * a), so every
+ * intermediate value has n + 1 bits and each reduce is one conditional subtraction of m
+ */
+class ModularMultiplier : public BitCircuit {
+private:
+    Bits mod;
+    
+    // x mod m for an (n + 1)-bit x < 2m: x - m when x >= m, else x, as n bits
+    Bits reduce(const Bits& x) {
+        const size_t n = mod.size();
+        // difference = x + ~m + 1; the final carry is set when x[0...n] >= m
+        Bits difference;
+        Bits carry{or_bit(x[0], -mod[0])};
+        difference.push_back(xor_bit(x[0], mod[0]));
+        for (size_t i = 1; i < n; ++i) {
+            Bits bits{x[i], -mod[i]};
+            bits.insert(bits.end(), carry.begin(), carry.end());
+            carry.clear();
+            difference.push_back(add_column(bits, carry));
+        }
+        const Literal subtract = or_bit(x[n], carry.empty() ? 0 : carry[0]);
+        Bits result(n);
+        for (size_t i = 0; i < n; ++i) {
+            result[i] = mux_bit(subtract, difference[i], x[i]);
+        }
+        return result;
+    }
+    
+public:
+    ModularMultiplier(GenerationContext& context, ClauseSink& out, const Sym& names, Bits mod)
+        : BitCircuit(context, out, names), mod(std::move(mod)) {}
+    
+    // a * b mod m for a < m (b is unrestricted)
+    Bits multiply(const Bits& a, const Bits& b) {
+        const size_t n = mod.size();
+        Bits remainder(n, 0);
+        for (size_t i = n; i-- > 0;) {
+            if (std::any_of(remainder.begin(), remainder.end(), [](Literal bit) { return bit != 0; })) {
+                Bits doubled{0};
+                doubled.insert(doubled.end(), remainder.begin(), remainder.end());
+                remainder = reduce(doubled);
+            }
+            Bits addend(n);
+            for (size_t j = 0; j < n; ++j) {
+                addend[j] = and_bit(b[i], a[j]);
+            }
+            remainder = reduce(add(remainder, addend));
+        }
+        return remainder;
+    }
+};
+
+/**
+ * Parallel-prefix carry network of Add_NBit (options.adder other than Ripple)
+ * Node i starts as the (generate, propagate) pair of bit i and is merged with lower groups until
+ * it covers bits i...0; its generate is then the carry into bit i + 1. The strategy only decides
+ * which nodes are merged at each level: Kogge-Stone every node with the one d below it,
+ * Sklansky the upper half of every 2d-block with the top of the lower half, Brent-Kung an
+ * up-sweep over power-of-two blocks and a down-sweep filling in the rest
+ */
+class PrefixAdder : public BitCircuit {
+private:
+    struct Group {
+        Literal generate;
+        Literal propagate;
+        int low;            // lowest bit covered
+    };
+    AdderStrategy strategy;
+    std::vector<Group> groups;
+    
+    // Merges group i with group j, which covers the bits just below it
+    void merge(std::vector<Group>& next, size_t i, size_t j) {
+        const Group& high = groups[i];
+        const Group& low = groups[j];
+        if (high.low == 0) {
+            return;
+        }
+        // The propagate of a group reaching bit 0 is never read
+        const Literal propagate = low.low == 0 ? 0 : and_bit(high.propagate, low.propagate);
+        next[i] = {generate_bit(high.generate, high.propagate, low.generate), propagate, low.low};
+    }
+    void level(const std::vector<std::pair<size_t, size_t>>& merges) {
+        std::vector<Group> next = groups;
+        for (const auto& [i, j] : merges) {
+            merge(next, i, j);
+        }
+        groups = std::move(next);
+    }
+    
+public:
+    PrefixAdder(GenerationContext& context, ClauseSink& out, const Sym& names, AdderStrategy strategy)
+        : BitCircuit(context, out, names), strategy(strategy) {}
+    
+    // Carries into bits 1...n for the given per-bit generate and propagate literals
+    Bits carries(const Bits& generate, const Bits& propagate) {
+        const size_t n = generate.size();
+        groups.clear();
+        for (size_t i = 0; i < n; ++i) {
+            groups.push_back({generate[i], propagate[i], static_cast<int>(i)});
+        }
+        std::vector<std::pair<size_t, size_t>> merges;
+        if (strategy == AdderStrategy::BrentKung) {
+            size_t top = 1;
+            for (size_t d = 1; d < n; d *= 2) {
+                merges.clear();
+                for (size_t i = 2 * d - 1; i < n; i += 2 * d) {
+                    merges.push_back({i, i - d});
+                }
+                level(merges);
+                top = d;
+            }
+            for (size_t d = top; d >= 1; d /= 2) {
+                merges.clear();
+                for (size_t i = 3 * d - 1; i < n; i += 2 * d) {
+                    merges.push_back({i, i - d});
+                }
+                level(merges);
+            }
+        } else {
+            for (size_t d = 1; d < n; d *= 2) {
+                merges.clear();
+                for (size_t i = d; i < n; ++i) {
+                    if (strategy == AdderStrategy::KoggeStone) {
+                        merges.push_back({i, i - d});
+                    } else if (i & d) {
+                        merges.push_back({i, (i & ~(d - 1)) - 1});
+                    }
+                }
+                level(merges);
+            }
+        }
+        Bits result;
+        for (const Group& group : groups) {
+            result.push_back(group.generate);
+        }
+        return result;
+    }
+};
+
+// Ties an n-bit result to the low half of a 2n-bit product and over_flow to the high half being nonzero
+void connect_product(GenerationContext& context, ClauseSink& out, const BitHeapMultiplier::Bits& product,
+                     const Sym& result, const Sym& over_flow, int n) {
+    for (int i = 0; i < n; ++i) {
+        const Literal r = var(result[i]);
+        const Literal bit = product[i];
+        if (bit == 0) {
+            out.add({-r});
+            continue;
+        }
+        if (alias_equivalence(context, out, r, bit)) {
+            continue;
+        }
+        if (context.options.constant_propagation && fold_equivalence(context, out, r, bit)) {
+            continue;
+        }
+        out.add({-r,  bit});
+        out.add({ r, -bit});
+    }
+    
+    // Overflow if and only if any bit of the high half is set
+    const Literal over = var(over_flow);
+    Clause overflow_clause{-over};
+    for (int i = n; i < 2 * n; ++i) {
+        if (product[i] != 0) {
+            overflow_clause.push_back(product[i]);
+            out.add({over, -product[i]});
+        }
+    }
+    out.add(overflow_clause);
+}
+
+}
+
+void Add_NBit::expand_prefix(ClauseSink& out, int call_count) const {
+    PrefixAdder adder(context, out, context.sym("AddNBit_Prefix")[call_count], context.options.adder);
+    PrefixAdder::Bits generate(n), propagate(n);
+    for (int i = 0; i < n; ++i) {
+        generate[i] = adder.and_bit(var(in_a[i]), var(in_b[i]));
+        if (i == 0) {
+            // Bit 0 has no carry-in, so its propagate is its sum
+            propagate[0] = var(result[0]);
+            emit_gate(context, out, xor_gate, GATE_XOR, {var(in_a[0]), var(in_b[0]), propagate[0]});
+        } else {
+            propagate[i] = adder.xor_bit(var(in_a[i]), var(in_b[i]));
+        }
+    }
+    const PrefixAdder::Bits carry = adder.carries(generate, propagate);
+    for (int i = 1; i < n; ++i) {
+        emit_gate(context, out, xor_gate, GATE_XOR, {propagate[i], carry[i - 1], var(result[i])});
+    }
+    adder.equate(var(over_flow), n == 0 ? 0 : carry[n - 1]);
+}
+
+namespace {
+
+// Ties result to the low half of the 2n-bit accumulator and over_flow to its high half being nonzero
+void connect_accumulator(GenerationContext& context, ClauseSink& out, const Sym& accum,
+                         const Sym& result, const Sym& over_flow, int n) {
+    
+    // Connect result to final accumulator value
+    for (int i = 0; i < n; ++i) {
+        const Literal r = var(result[i]);
+        const Literal bit = var(accum[i]);
+        if (alias_equivalence(context, out, r, bit)) {
+            continue;
+        }
+        if (context.options.constant_propagation && fold_equivalence(context, out, r, bit)) {
+            continue;
+        }
+        out.add({-r,  bit});
+        out.add({ r, -bit});
+    }
+    
+    // Generate overflow condition: if any upper bits are set, overflow occurs
+    const Literal over = var(over_flow);
+    Clause overflow_clause(n + 1);
+    overflow_clause[0] = -over;
+    for (int i = 0; i < n; ++i) {
+        overflow_clause[i + 1] = var(accum[i + n]);
+    }
+    out.add(overflow_clause);
+    
+    // If overflow is set, at least one upper bit must be set
+    for (int i = 0; i < n; ++i) {
+        out.add({over, -var(accum[i + n])});
+    }
+}
+
+}
+
+/**
+ * Class to represent N-bit multiplication: in_a * in_b == result
+ * Implements multiplication using shift-and-add algorithm, or with options.multiplier a
+ * Wallace, Dadda or Karatsuba circuit built by BitHeapMultiplier
+ */
+Mul_NBit::Mul_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                   const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
+
+void Mul_NBit::expand(ClauseSink& out) const {
+    
+    const int call_count = context.next_instance<Mul_NBit>();
+    if (context.options.multiplier != MultiplierStrategy::Array) {
+        expand_tree(out, call_count);
+        return;
+    }
+    const Sym accum1 = context.sym("Mul_NBit_Accum1")[call_count];
+    const Sym accum2 = context.sym("Mul_NBit_Accum2")[call_count];
+    
+    // Generate partial products for each bit of in_b
+    for (int i = 0; i < n; ++i) {
+        Mul_NBit_1Bit_Shift mul_shift(
+            context,
+            in_a,
+            in_b[i],
+            accum1[i],
+            i,
+            n
+        );
+        mul_shift.expand(out);
+    }
+
+    // Initialize accumulator to 0
+    for (int i = 0; i < n * 2; ++i) {
+        out.add({-var(accum2[0][i])});
+    }
+    
+    // Add partial products to accumulator
+    for (int i = 0; i < n; ++i) {
+        Add_NBit add_nbit(
+            context,
+            accum1[i],
+            accum2[i],
+            accum2[i + 1],
+            context.sym("Mul_NBit_CarryOut")[call_count][i],
+            n * 2
+        );
+        add_nbit.expand(out);
+    }
+    
+    connect_accumulator(context, out, accum2[n], result, over_flow, n);
+    
+}
+
+void Mul_NBit::expand_tree(ClauseSink& out, int call_count) const {
+    BitHeapMultiplier multiplier(context, out, context.sym("Mul_NBit_Tree")[call_count], context.options.multiplier);
+    BitHeapMultiplier::Bits a(n), b(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = var(in_a[i]);
+        b[i] = var(in_b[i]);
+    }
+    connect_product(context, out, multiplier.multiply(a, b), result, over_flow, n);
+}
+
+/**
+ * Class to represent N-bit squaring: in_a * in_a == result
+ * With the default array multiplier this is Mul_NBit(in_a, in_a), unless options.symmetric_square
+ * selects the symmetric array below; with options.multiplier set the square is built from the
+ * folded, symmetric partial products (BitHeapMultiplier::square), reduced by the selected tree
+ * (Dadda for Karatsuba)
  */
-Input_Equals_Number::Input_Equals_Number(const std::string& input, int value, int n) 
-    : input(input), value(value), n(n) {}
+Square_NBit::Square_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), result(result), over_flow(over_flow), n(n) {}
 
-std::vector<std::string> Input_Equals_Number::expand() const {
-    std::vector<std::string> result;
+void Square_NBit::expand(ClauseSink& out) const {
+    if (context.options.multiplier == MultiplierStrategy::Array && !context.options.symmetric_square) {
+        Mul_NBit(context, in_a, in_a, result, over_flow, n).expand(out);
+        return;
+    }
+    const int call_count = context.next_instance<Square_NBit>();
+    if (context.options.multiplier == MultiplierStrategy::Array) {
+        expand_array(out, call_count);
+        return;
+    }
+    const MultiplierStrategy reduction = context.options.multiplier == MultiplierStrategy::Wallace
+        ? MultiplierStrategy::Wallace : MultiplierStrategy::Dadda;
+    BitHeapMultiplier multiplier(context, out, context.sym("Square_NBit_Tree")[call_count], reduction);
+    BitHeapMultiplier::Bits a(n);
     for (int i = 0; i < n; ++i) {
-        if (((value >> i) & 1) == 1) {
-            result.push_back("<" + input + "_" + Z(i) + "> 0 ");
+        a[i] = var(in_a[i]);
+    }
+    connect_product(context, out, multiplier.square(a), result, over_flow, n);
+}
+
+/**
+ * Symmetric shift-and-add squaring (options.symmetric_square)
+ * in_a^2 is the sum over i of in_a[i] << 2i (a_i * a_i == a_i) plus, for each i < j, the
+ * product a_i * a_j counted twice, i.e. placed once at column i + j + 1; row i holds a_i at
+ * column 2i and its products with the higher bits, so only n(n-1)/2 ANDs are built instead of
+ * n^2, and the rows are added up as in Mul_NBit
+ */
+void Square_NBit::expand_array(ClauseSink& out, int call_count) const {
+    const Sym accum1 = context.sym("Square_NBit_Accum1")[call_count];
+    const Sym accum2 = context.sym("Square_NBit_Accum2")[call_count];
+    
+    // Row i: a_i at column 2i, a_i AND a_j at column i + j + 1 for j > i, 0 elsewhere
+    for (int i = 0; i < n; ++i) {
+        const Literal a = var(in_a[i]);
+        for (int k = 0; k < n * 2; ++k) {
+            const Literal r = var(accum1[i][k]);
+            if (k == 2 * i) {
+                if (alias_equivalence(context, out, r, a)) {
+                    continue;
+                }
+                if (context.options.constant_propagation && fold_equivalence(context, out, r, a)) {
+                    continue;
+                }
+                out.add({-r,  a});
+                out.add({ r, -a});
+                continue;
+            }
+            if (k < 2 * i + 2 || k > i + n) {
+                out.add({-r});
+                continue;
+            }
+            const Literal b = var(in_a[k - i - 1]);
+            const Literal operands[] = {a, b, r};
+            if (context.options.constant_propagation && fold_gate(context, out, and_gate, operands)) {
+                continue;
+            }
+            out.add({ r, -a, -b});
+            out.add({-r, -a,  b});
+            out.add({-r,  a, -b});
+            out.add({-r,  a,  b});
+        }
+    }
+    
+    // Initialize accumulator to 0
+    for (int i = 0; i < n * 2; ++i) {
+        out.add({-var(accum2[0][i])});
+    }
+    
+    // Add the rows to the accumulator
+    for (int i = 0; i < n; ++i) {
+        Add_NBit(context, accum1[i], accum2[i], accum2[i + 1],
+                 context.sym("Square_NBit_CarryOut")[call_count][i], n * 2).expand(out);
+    }
+    
+    connect_accumulator(context, out, accum2[n], result, over_flow, n);
+}
+
+/**
+ * Class to represent N-bit modular multiplication: result == (in_a * in_b) % mod, for in_a < mod
+ * Interleaves shift-and-add with conditional subtraction of mod (ModularMultiplier), so no
+ * 2N-bit product or quotient is built
+ */
+ModMul_NBit::ModMul_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& mod,
+                         const Sym& result, int n)
+    : context(context), in_a(in_a), in_b(in_b), mod(mod), result(result), n(n) {}
+
+void ModMul_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<ModMul_NBit>();
+    ModularMultiplier::Bits a(n), b(n), m(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = var(in_a[i]);
+        b[i] = var(in_b[i]);
+        m[i] = var(mod[i]);
+    }
+    ModularMultiplier multiplier(context, out, context.sym("ModMul_NBit")[call_count], std::move(m));
+    const ModularMultiplier::Bits product = multiplier.multiply(a, b);
+    for (int i = 0; i < n; ++i) {
+        multiplier.equate(var(result[i]), product[i]);
+    }
+}
+
+namespace {
+
+// Number of threads for options.threads (0 = one per core)
+unsigned resolved_threads(unsigned threads) {
+    return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Compression of an output file, chosen by its extension
+enum class Compression { None, Gzip, Xz };
+
+Compression compression_for(const std::string& file_path) {
+    const auto ends_with = [&file_path](const char* suffix) {
+        const size_t length = std::strlen(suffix);
+        return file_path.size() >= length && file_path.compare(file_path.size() - length, length, suffix) == 0;
+    };
+    if (ends_with(".gz")) {
+        return Compression::Gzip;
+    }
+    if (ends_with(".xz")) {
+        return Compression::Xz;
+    }
+    return Compression::None;
+}
+
+// Whether this build can write the given compression (zlib and liblzma are optional)
+bool compression_supported(Compression compression) {
+    switch (compression) {
+    case Compression::Gzip:
+#ifdef HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Compression::Xz:
+#ifdef HAVE_LZMA
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+/**
+ * Compresses one block into a self-contained gzip member or xz stream
+ * Concatenated members (streams) form a valid .gz (.xz) file, so blocks can be compressed
+ * independently and in parallel; returns false on a library error
+ */
+bool compress_block(Compression compression, const std::vector<char>& data, std::string& packed) {
+#ifdef HAVE_ZLIB
+    if (compression == Compression::Gzip) {
+        z_stream stream{};
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        packed.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(packed.data());
+        stream.avail_out = static_cast<uInt>(packed.size());
+        const bool finished = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        packed.resize(stream.total_out);
+        deflateEnd(&stream);
+        return finished;
+    }
+#endif
+#ifdef HAVE_LZMA
+    if (compression == Compression::Xz) {
+        packed.resize(lzma_stream_buffer_bound(data.size()));
+        size_t written = 0;
+        const lzma_ret result = lzma_easy_buffer_encode(6, LZMA_CHECK_CRC64, nullptr,
+            reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+            reinterpret_cast<uint8_t*>(packed.data()), &written, packed.size());
+        packed.resize(written);
+        return result == LZMA_OK;
+    }
+#endif
+    (void)data;
+    (void)packed;
+    return compression == Compression::None;
+}
+
+/**
+ * Output stream buffer that hands every full block to background threads
+ * A writer thread writes the blocks in order, so formatting and file I/O overlap. When the file
+ * name ends in .gz or .xz, worker threads first compress the blocks in parallel (see
+ * compress_block). At most max_pending blocks are in flight, so the memory used does not
+ * depend on the size of the file
+ */
+class BackgroundFileBuffer : public std::streambuf {
+private:
+    struct Job {
+        std::vector<char> data;
+        std::string packed;
+        bool claimed = false;
+        bool done = false;
+    };
+    const Compression compression;
+    const size_t block_size;
+    const size_t max_pending;
+    std::ofstream file;
+    std::vector<char> block;
+    std::deque<std::unique_ptr<Job>> jobs;
+    std::vector<std::vector<char>> spare;   // written blocks, reused by submit()
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool closing = false;
+    bool failed = false;
+    std::thread writer;
+    std::vector<std::thread> compressors;
+    size_t submitted = 0;
+
+    void write_blocks() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return (closing && jobs.empty()) || (!jobs.empty() && jobs.front()->done); });
+            if (jobs.empty()) {
+                return;
+            }
+            std::unique_ptr<Job> job = std::move(jobs.front());
+            jobs.pop_front();
+            changed.notify_all();
+            lock.unlock();
+            if (compression == Compression::None) {
+                file.write(job->data.data(), static_cast<std::streamsize>(job->data.size()));
+            } else {
+                file.write(job->packed.data(), static_cast<std::streamsize>(job->packed.size()));
+            }
+            lock.lock();
+            if (compression == Compression::None) {
+                spare.push_back(std::move(job->data));
+            }
+        }
+    }
+    void compress_blocks() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            Job* job = nullptr;
+            changed.wait(lock, [this, &job] {
+                for (const auto& pending : jobs) {
+                    if (!pending->claimed) {
+                        job = pending.get();
+                        return true;
+                    }
+                }
+                return closing;
+            });
+            if (job == nullptr) {
+                return;
+            }
+            job->claimed = true;
+            lock.unlock();
+            const bool packed = compress_block(compression, job->data, job->packed);
+            lock.lock();
+            spare.push_back(std::move(job->data));
+            failed = failed || !packed;
+            job->done = true;
+            changed.notify_all();
+        }
+    }
+    // Queues the filled part of the current block and starts a new one, reusing a written block
+    // when there is one
+    void submit() {
+        block.resize(static_cast<size_t>(pptr() - pbase()));
+        if (!block.empty()) {
+            auto job = std::make_unique<Job>();
+            job->data = std::move(block);
+            job->done = compression == Compression::None;
+            submitted += job->data.size();
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return jobs.size() < max_pending; });
+            jobs.push_back(std::move(job));
+            block.clear();
+            if (!spare.empty()) {
+                block = std::move(spare.back());
+                spare.pop_back();
+            }
+            lock.unlock();
+            changed.notify_all();
+        }
+        block.resize(block_size);
+        setp(block.data(), block.data() + block.size());
+    }
+protected:
+    int_type overflow(int_type ch) override {
+        submit();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+    int sync() override {
+        submit();
+        return 0;
+    }
+public:
+    // threads is the number of compression workers (0 = one per core); unused for plain files
+    explicit BackgroundFileBuffer(const std::string& file_path, unsigned threads = 0)
+        : compression(compression_for(file_path)),
+          block_size(compression == Compression::Xz ? size_t{8} << 20 : size_t{1} << 20),
+          max_pending(compression == Compression::None ? 4 : 2 * resolved_threads(threads)),
+          block(block_size) {
+        setp(block.data(), block.data() + block.size());
+        if (!compression_supported(compression)) {
+            std::cerr << "Error: this build cannot write " << file_path << " (built without "
+                      << (compression == Compression::Gzip ? "zlib" : "liblzma") << ")" << std::endl;
+            return;
+        }
+        file.open(file_path, std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        writer = std::thread(&BackgroundFileBuffer::write_blocks, this);
+        if (compression != Compression::None) {
+            for (unsigned i = 0; i < resolved_threads(threads); ++i) {
+                compressors.emplace_back(&BackgroundFileBuffer::compress_blocks, this);
+            }
+        }
+    }
+    ~BackgroundFileBuffer() override { close(); }
+    bool is_open() const { return file.is_open(); }
+    bool compressed() const { return compression != Compression::None; }
+    // Number of (uncompressed) bytes put into the buffer so far
+    size_t size() const { return submitted + static_cast<size_t>(pptr() - pbase()); }
+    // Writes the last block, stops the threads and closes the file; returns false if a write failed
+    bool close() {
+        if (!writer.joinable()) {
+            return false;
+        }
+        submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        changed.notify_all();
+        for (std::thread& compressor : compressors) {
+            compressor.join();
+        }
+        writer.join();
+        file.close();
+        return !file.fail() && !failed;
+    }
+};
+
+// Number of threads to use for count items: options.threads (0 = one per core), at most one per 4096 items
+unsigned worker_count(unsigned threads, size_t count) {
+    return static_cast<unsigned>(std::clamp<size_t>(count / 4096, 1, resolved_threads(threads)));
+}
+
+/**
+ * Splits [0, count) into one contiguous chunk per worker and runs work(worker, begin, end) on each,
+ * chunk 0 on the calling thread; returns when every chunk is done
+ */
+template <typename Work>
+void parallel_chunks(unsigned workers, size_t count, Work work) {
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; ++w) {
+        threads.emplace_back(work, w, count * w / workers, count * (w + 1) / workers);
+    }
+    work(0u, size_t{0}, count / workers);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * File written with pwrite at explicit offsets, so several threads can write disjoint ranges
+ * at the same time; the file is opened without truncation, after the header has been written
+ * Each batch of texts is preallocated (posix_fallocate) once its end offset is known, before
+ * the parallel writes, so they do not each extend the file
+ */
+class PositionalFile {
+private:
+    int descriptor;
+    std::atomic<bool> failed{false};
+public:
+    explicit PositionalFile(const std::string& file_path) : descriptor(::open(file_path.c_str(), O_WRONLY)) {}
+    PositionalFile(const PositionalFile&) = delete;
+    PositionalFile& operator=(const PositionalFile&) = delete;
+    ~PositionalFile() { close(); }
+    bool is_open() const { return descriptor >= 0; }
+    void write_at(const char* data, size_t size, size_t offset) {
+        while (size > 0) {
+            const ssize_t written = ::pwrite(descriptor, data, size, static_cast<off_t>(offset));
+            if (written <= 0) {
+                failed = true;
+                return;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<size_t>(written);
+        }
+    }
+    // Writes each text at offset and the texts back to back in order; returns the offset after the last one
+    size_t write_in_order(const std::vector<std::string>& texts, size_t offset) {
+        std::vector<size_t> offsets(texts.size());
+        for (size_t i = 0; i < texts.size(); ++i) {
+            offsets[i] = offset;
+            offset += texts[i].size();
+        }
+        // Best effort: on file systems without fallocate support the pwrites still extend the file
+        if (!texts.empty() && offset > offsets.front()) {
+            ::posix_fallocate(descriptor, static_cast<off_t>(offsets.front()), static_cast<off_t>(offset - offsets.front()));
+        }
+        parallel_chunks(static_cast<unsigned>(texts.size()), texts.size(), [&](unsigned, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                write_at(texts[i].data(), texts[i].size(), offsets[i]);
+            }
+        });
+        return offset;
+    }
+    // Closes the file; returns false if a write failed
+    bool close() {
+        if (descriptor < 0) {
+            return false;
+        }
+        const bool closed = ::close(descriptor) == 0;
+        descriptor = -1;
+        return closed && !failed;
+    }
+};
+
+// Appends one clause as a DIMACS line, renumbered through literal_map, to text
+void append_clause_text(std::string& text, std::span<const Literal> clause, const std::vector<int>& literal_map) {
+    size_t cursor = text.size();
+    text.resize(cursor + clause.size() * 12 + 2);
+    char* const begin = text.data();
+    for (Literal literal : clause) {
+        literal = literal < 0 ? -literal_map[-literal] : literal_map[literal];
+        cursor = static_cast<size_t>(std::to_chars(begin + cursor, begin + text.size(), literal).ptr - begin);
+        begin[cursor++] = ' ';
+    }
+    begin[cursor++] = '0';
+    begin[cursor++] = '\n';
+    text.resize(cursor);
+}
+
+/**
+ * Sink that formats clauses to text on several threads and writes them with pwrite
+ * Clauses are collected into blocks; each block is split into one contiguous chunk per worker,
+ * the chunks are formatted in parallel into their own buffers and written back to back at
+ * offsets computed from the buffer sizes, so the file matches the sequential FileSink output
+ */
+class PositionalFileSink : public ClauseSink {
+private:
+    static constexpr size_t block_clauses = size_t{1} << 20;
+    PositionalFile& file;
+    const std::vector<int>& literal_map;
+    unsigned workers;
+    size_t offset;
+    ClauseDatabase block;
+    std::vector<std::string> texts;
+public:
+    PositionalFileSink(PositionalFile& file, const std::vector<int>& literal_map, unsigned workers, size_t offset)
+        : file(file), literal_map(literal_map), workers(workers), offset(offset), texts(workers) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        block.add(clause);
+        if (block.size() >= block_clauses) {
+            flush();
+        }
+    }
+    void flush() {
+        parallel_chunks(workers, block.size(), [this](unsigned worker, size_t first, size_t last) {
+            texts[worker].clear();
+            for (size_t i = first; i < last; ++i) {
+                append_clause_text(texts[worker], block[i], literal_map);
+            }
+        });
+        offset = file.write_in_order(texts, offset);
+        block.clear();
+    }
+};
+
+/**
+ * Writes the indexed symbol map read by SymbolMap (native byte order, 8-byte aligned):
+ *   header    "CNFSYM1" + '\0', then count, entries offset, by_id offset (64-bit each)
+ *   names     every name without angle brackets, back to back in name order
+ *   entries   count SymbolMap::Entry {name offset, name length, id}, in name order
+ *   by_id     count 32-bit entry indices ordered by id (ties in name order)
+ * Names are ordered the way their "<name>" forms compare, like the "cv" lines
+ */
+bool write_symbol_map(const std::string& file_path, const VariableRegistry& registry,
+                      const std::vector<int>& ids, const std::vector<int>& literal_map) {
+    std::ofstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    unsigned long long header[4] = {};
+    std::memcpy(header, "CNFSYM1", 8);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    
+    std::vector<SymbolMap::Entry> entries(ids.size());
+    unsigned long long offset = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const std::string name = registry.name(ids[i]);
+        entries[i] = {offset, static_cast<unsigned int>(name.size()), literal_map[ids[i]]};
+        file.write(name.data(), static_cast<std::streamsize>(name.size()));
+        offset += name.size();
+    }
+    const char padding[8] = {};
+    file.write(padding, static_cast<std::streamsize>((8 - offset % 8) % 8));
+    header[1] = ids.size();
+    header[2] = sizeof(header) + offset + (8 - offset % 8) % 8;
+    file.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(SymbolMap::Entry)));
+    
+    std::vector<unsigned int> by_id(ids.size());
+    for (size_t i = 0; i < by_id.size(); ++i) {
+        by_id[i] = static_cast<unsigned int>(i);
+    }
+    std::stable_sort(by_id.begin(), by_id.end(), [&entries](unsigned int a, unsigned int b) {
+        return entries[a].id < entries[b].id;
+    });
+    header[3] = header[2] + entries.size() * sizeof(SymbolMap::Entry);
+    file.write(reinterpret_cast<const char*>(by_id.data()), static_cast<std::streamsize>(by_id.size() * sizeof(unsigned int)));
+    
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.close();
+    return !file.fail();
+}
+
+// Forwards every clause to two sinks
+class TeeSink : public ClauseSink {
+private:
+    ClauseSink& first;
+    ClauseSink& second;
+public:
+    TeeSink(ClauseSink& first, ClauseSink& second) : first(first), second(second) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        first.add(clause);
+        second.add(clause);
+    }
+};
+
+/**
+ * Sink for the first pass over a formula: counts clauses and marks every variable that occurs
+ * On request it also lists the variables in order of first occurrence, records the first gate
+ * definition of each variable (definition_start[v] indexes a count followed by the inputs in
+ * definition_inputs, 0 when v is not defined) and keeps the clauses in held
+ */
+class UsageSink : public ClauseSink {
+public:
+    std::vector<char> used;
+    size_t clauses = 0;
+    bool track_first_use = false;
+    std::vector<int> first_use;
+    bool track_definitions = false;
+    std::vector<size_t> definition_start;
+    std::vector<int> definition_inputs = std::vector<int>(1, 0);
+    ClauseDatabase* held = nullptr;
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        for (Literal literal : clause) {
+            size_t id = std::abs(literal);
+            if (id >= used.size()) {
+                used.resize(std::max(id + 1, used.size() * 2), 0);
+            }
+            if (track_first_use && !used[id]) {
+                first_use.push_back(static_cast<int>(id));
+            }
+            used[id] = 1;
+        }
+        ++clauses;
+        if (held != nullptr) {
+            held->add(clause);
+        }
+    }
+    void define(Literal output, std::span<const Literal> inputs) override {
+        if (!track_definitions) {
+            return;
+        }
+        const size_t id = std::abs(output);
+        if (id >= definition_start.size()) {
+            definition_start.resize(std::max(id + 1, definition_start.size() * 2), 0);
+        }
+        if (definition_start[id] != 0) {
+            return;
+        }
+        definition_start[id] = definition_inputs.size();
+        definition_inputs.push_back(static_cast<int>(inputs.size()));
+        for (Literal input : inputs) {
+            definition_inputs.push_back(std::abs(input));
+        }
+    }
+};
+
+/**
+ * Orders the used variables for --numbering=topological: a depth-first walk from each
+ * variable in first-use order lists the inputs of every gate before its output, so the cone of
+ * one gate gets consecutive numbers and the circuit inputs come before everything they feed
+ */
+std::vector<int> topological_order(const UsageSink& usage, const std::vector<char>& used) {
+    std::vector<int> order;
+    std::vector<char> state(used.size(), 0);
+    std::vector<std::pair<int, int>> stack;
+    for (int start : usage.first_use) {
+        if (state[start] != 0) {
+            continue;
+        }
+        state[start] = 1;
+        stack.emplace_back(start, 0);
+        while (!stack.empty()) {
+            auto& [id, next] = stack.back();
+            const size_t definition = static_cast<size_t>(id) < usage.definition_start.size() ? usage.definition_start[id] : 0;
+            if (definition != 0 && next < usage.definition_inputs[definition]) {
+                const int input = usage.definition_inputs[definition + 1 + next++];
+                if (static_cast<size_t>(input) < state.size() && state[input] == 0) {
+                    state[input] = 1;
+                    stack.emplace_back(input, 0);
+                }
+                continue;
+            }
+            if (used[id]) {
+                order.push_back(id);
+            }
+            stack.pop_back();
+        }
+    }
+    return order;
+}
+
+// Orders the variables of usage for --numbering=instance: grouped by registry.instance(), the
+// groups in order of their first used variable, each group in first-use order
+std::vector<int> instance_order(const UsageSink& usage, const VariableRegistry& registry) {
+    std::unordered_map<int, int> ranks;
+    std::vector<int> rank_of(usage.first_use.size());
+    std::vector<size_t> bucket(1, 0);
+    for (size_t i = 0; i < usage.first_use.size(); ++i) {
+        auto [it, inserted] = ranks.emplace(registry.instance(usage.first_use[i]), static_cast<int>(ranks.size()));
+        if (inserted) {
+            bucket.push_back(0);
+        }
+        rank_of[i] = it->second;
+        ++bucket[it->second + 1];
+    }
+    for (size_t r = 1; r < bucket.size(); ++r) {
+        bucket[r] += bucket[r - 1];
+    }
+    std::vector<int> order(usage.first_use.size());
+    for (size_t i = 0; i < usage.first_use.size(); ++i) {
+        order[bucket[rank_of[i]]++] = usage.first_use[i];
+    }
+    return order;
+}
+
+// Forwards clauses to another sink and reports progress in 5% steps
+class ProgressSink : public ClauseSink {
+private:
+    ClauseSink& next;
+    size_t step;
+    size_t count = 0;
+public:
+    ProgressSink(ClauseSink& next, size_t total) : next(next), step(std::max<size_t>(1, total / 20)) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        if ((count % step) == 0) {
+            std::cerr << (5 * count / step) << "%..." << std::endl;
+        }
+        ++count;
+        next.add(clause);
+    }
+};
+
+/**
+ * Writes a formula as a DIMACS CNF file in two passes over emit
+ * The first pass only collects the used variables and the clause count; the second pass
+ * streams the renumbered clauses to the file, so no clause is held in memory by the writer
+ * By default variables are renumbered so that lowercase (user) names come first and names are
+ * sorted within each group; options.numbering selects first-use, topological or per-instance
+ * numbering instead. The "cv" lines list every variable in name order either way
+ * With options.clause_order == ClauseOrder::Variables the first pass keeps the clauses, which
+ * are then written ordered by their largest variable number (ties in emission order)
+ * ClauseOrder::Canonical sorts the literals of each renumbered clause by variable and then the
+ * clauses themselves, so together with the name numbering (which depends only on the names,
+ * never on the order in which they were met) the file depends only on the formula
+ * options.verify_digest prints a 64-bit FNV-1a digest of the symbol table and of the
+ * renumbered clauses in file order; it does not depend on the file format or compression
+ * With options.binary the clauses are written in the binary format and the "cv" lines to a
+ * separate ".sym" file; binary_cnf_to_dimacs() turns the pair back into DIMACS text
+ * options.symbol_map moves the names to an indexed ".symbols" file (see write_symbol_map) and
+ * options.user_symbols_only lists only the lowercase names
+ */
+void write_cnf(const GenerationContext& context, const ClauseEmitter& emit, const std::string& file_path) {
+    const bool verbose = context.options.progress;
+    if (verbose) {
+        std::cerr << "gather literals..." << std::endl;
+    }
+    const VariableNumbering numbering = context.options.numbering;
+    ClauseDatabase held;
+    UsageSink usage;
+    usage.track_first_use = numbering != VariableNumbering::Name;
+    usage.track_definitions = numbering == VariableNumbering::Topological;
+    if (context.options.clause_order != ClauseOrder::Emit) {
+        usage.held = &held;
+    }
+    emit(usage);
+    
+    const VariableRegistry& registry = context.variables();
+    std::vector<char> used = std::move(usage.used);
+    used.resize(registry.size() + 1, 0);
+    // An aliased name is listed when any name of its class is used
+    for (int id = 1; id <= registry.size(); ++id) {
+        used[context.representative(id)] |= used[id];
+    }
+    for (int id = 1; id <= registry.size(); ++id) {
+        used[id] = used[context.representative(id)];
+    }
+    
+    if (verbose) {
+        std::cerr << "sorting literals..." << std::endl;
+    }
+    std::vector<int> by_name = registry.name_order(used);
+    std::vector<int> literals;
+    if (numbering == VariableNumbering::FirstUse) {
+        literals = std::move(usage.first_use);
+    } else if (numbering == VariableNumbering::Topological) {
+        literals = topological_order(usage, used);
+    } else if (numbering == VariableNumbering::Instance) {
+        literals = instance_order(usage, registry);
+    } else {
+        literals = by_name;
+        std::stable_partition(literals.begin(), literals.end(), [&registry](int id) {
+            return !std::isupper(static_cast<unsigned char>(registry.initial(id)));
+        });
+    }
+    
+    if (verbose) {
+        std::cerr << "mapping symbol to integer..." << std::endl;
+    }
+    std::vector<int> literal_map(registry.size() + 1, 0);
+    int variable_count = 0;
+    for (int id : literals) {
+        const int root = context.representative(id);
+        if (literal_map[root] == 0) {
+            literal_map[root] = ++variable_count;
+        }
+        literal_map[id] = literal_map[root];
+    }
+    // Names listed only through an alias class do not occur in the clauses themselves
+    for (int id : by_name) {
+        const int root = context.representative(id);
+        if (literal_map[root] == 0) {
+            literal_map[root] = ++variable_count;
+        }
+        literal_map[id] = literal_map[root];
+    }
+    
+    std::vector<size_t> clause_order;
+    std::vector<int> identity;
+    const std::vector<int>* clause_map = &literal_map;
+    if (context.options.clause_order == ClauseOrder::Canonical) {
+        // The held clauses are replaced by their renumbered, sorted forms, written unmapped
+        const auto literal_less = [](Literal a, Literal b) {
+            return std::abs(a) != std::abs(b) ? std::abs(a) < std::abs(b) : a < b;
+        };
+        ClauseDatabase canonical;
+        Clause scratch;
+        for (size_t i = 0; i < held.size(); ++i) {
+            scratch.assign(held[i].begin(), held[i].end());
+            for (Literal& literal : scratch) {
+                literal = literal < 0 ? -literal_map[-literal] : literal_map[literal];
+            }
+            std::sort(scratch.begin(), scratch.end(), literal_less);
+            canonical.add(scratch);
+        }
+        held = std::move(canonical);
+        clause_order.resize(held.size());
+        for (size_t i = 0; i < held.size(); ++i) {
+            clause_order[i] = i;
+        }
+        std::sort(clause_order.begin(), clause_order.end(), [&held, &literal_less](size_t a, size_t b) {
+            const std::span<const Literal> x = held[a];
+            const std::span<const Literal> y = held[b];
+            return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end(), literal_less);
+        });
+        identity.resize(static_cast<size_t>(variable_count) + 1);
+        for (size_t id = 0; id < identity.size(); ++id) {
+            identity[id] = static_cast<int>(id);
+        }
+        clause_map = &identity;
+    } else if (context.options.clause_order == ClauseOrder::Variables) {
+        // Counting sort of the held clauses by their largest new variable number
+        std::vector<size_t> bucket(static_cast<size_t>(variable_count) + 2, 0);
+        std::vector<int> keys(held.size(), 0);
+        for (size_t i = 0; i < held.size(); ++i) {
+            for (Literal literal : held[i]) {
+                keys[i] = std::max(keys[i], literal_map[std::abs(literal)]);
+            }
+            ++bucket[keys[i] + 1];
+        }
+        for (size_t key = 1; key < bucket.size(); ++key) {
+            bucket[key] += bucket[key - 1];
+        }
+        clause_order.resize(held.size());
+        for (size_t i = 0; i < held.size(); ++i) {
+            clause_order[bucket[keys[i]]++] = i;
+        }
+    }
+    const ClauseEmitter sorted = [&held, &clause_order](ClauseSink& sink) {
+        for (size_t i : clause_order) {
+            sink.add(held[i]);
+        }
+    };
+    const ClauseEmitter& source = context.options.clause_order != ClauseOrder::Emit ? sorted : emit;
+    
+    if (verbose) {
+        std::cerr << "writing cnf to file..." << std::endl;
+    }
+    BackgroundFileBuffer output(file_path, context.options.threads);
+    if (!output.is_open()) {
+        std::cerr << "Error: Could not open file " << file_path << " for writing" << std::endl;
+        return;
+    }
+    std::ostream file(&output);
+    HashingSink digest(clause_map);
+    if (context.options.verify_digest) {
+        for (int id : by_name) {
+            digest.add_name(registry.name(id), literal_map[id]);
+        }
+    }
+    const auto emit_clauses = [&](ClauseSink& sink) {
+        TeeSink hashed(sink, digest);
+        ClauseSink& target = context.options.verify_digest ? static_cast<ClauseSink&>(hashed) : sink;
+        if (verbose) {
+            ProgressSink progress(target, usage.clauses);
+            source(progress);
         } else {
-            result.push_back("-<" + input + "_" + Z(i) + "> 0 ");
+            source(target);
+        }
+    };
+    const auto report_digest = [&]() {
+        if (context.options.verify_digest) {
+            std::cout << "CNF digest: " << std::hex << std::setw(16) << std::setfill('0') << digest.digest()
+                      << std::dec << std::setfill(' ') << " " << file_path << std::endl;
+        }
+    };
+    
+    // Names to list: all of them, or only the user (lowercase) ones; with options.symbol_map they
+    // go to an indexed sidecar file instead of "cv" lines
+    std::vector<int> listed;
+    const std::vector<int>* listed_names = &by_name;
+    if (context.options.user_symbols_only) {
+        std::copy_if(by_name.begin(), by_name.end(), std::back_inserter(listed), [&registry](int id) {
+            return !std::isupper(static_cast<unsigned char>(registry.initial(id)));
+        });
+        listed_names = &listed;
+    }
+    if (context.options.symbol_map) {
+        if (!write_symbol_map(file_path + ".symbols", registry, *listed_names, literal_map)) {
+            std::cerr << "Error: Could not write file " << file_path << ".symbols" << std::endl;
+            return;
+        }
+        listed.clear();
+        listed_names = &listed;
+    }
+    
+    if (context.options.binary) {
+        // Binary format: "BCNF", then varints version (1), variable count and clause count,
+        // then each clause as written by BinarySink; the "cv" lines go to file_path + ".sym"
+        std::ofstream symbols;
+        if (!listed_names->empty()) {
+            symbols.open(file_path + ".sym");
+            if (!symbols.is_open()) {
+                std::cerr << "Error: Could not open file " << file_path << ".sym for writing" << std::endl;
+                return;
+            }
+        }
+        for (int id : *listed_names) {
+            symbols << "cv <" << registry.name(id) << "> " << literal_map[id] << "\n";
+        }
+        std::string header = "BCNF";
+        append_varint(header, 1);
+        append_varint(header, static_cast<unsigned long long>(variable_count));
+        append_varint(header, usage.clauses);
+        file.write(header.data(), static_cast<std::streamsize>(header.size()));
+        BinarySink sink(file, clause_map);
+        emit_clauses(sink);
+        if (!output.close() || (symbols.is_open() && !symbols.flush())) {
+            std::cerr << "Error: Could not write file " << file_path << std::endl;
+            return;
+        }
+        if (verbose) {
+            std::cerr << "CNF file generated successfully: " << file_path << std::endl;
+        }
+        report_digest();
+        return;
+    }
+    
+    file << "c\n";
+    file << "c\n";
+    file << "c\n";
+    
+    for (int id : *listed_names) {
+        file << "cv <" << registry.name(id) << "> " << literal_map[id] << "\n";
+    }
+    
+    file << "p cnf " << variable_count << " " << usage.clauses << "\n";
+    
+    const unsigned workers = worker_count(context.options.threads, usage.clauses);
+    if (workers > 1 && !output.compressed()) {
+        // The clauses are formatted on several threads and written with pwrite after the header
+        const size_t header_size = output.size();
+        if (!output.close()) {
+            std::cerr << "Error: Could not write file " << file_path << std::endl;
+            return;
+        }
+        PositionalFile positional(file_path);
+        PositionalFileSink sink(positional, *clause_map, workers, header_size);
+        emit_clauses(sink);
+        sink.flush();
+        if (!positional.close()) {
+            std::cerr << "Error: Could not write file " << file_path << std::endl;
+            return;
+        }
+    } else {
+        FileSink sink(file, clause_map);
+        emit_clauses(sink);
+        if (!output.close()) {
+            std::cerr << "Error: Could not write file " << file_path << std::endl;
+            return;
+        }
+    }
+    if (verbose) {
+        std::cerr << "CNF file generated successfully: " << file_path << std::endl;
+    }
+    report_digest();
+}
+
+}
+
+void generate_cnf(const GenerationContext& context, const ClauseDatabase& conditions, const std::string& file_path) {
+    write_cnf(context, emitter(conditions), file_path);
+}
+
+void generate_cnf(const ConstraintDag& conditions, const std::string& file_path) {
+    write_cnf(conditions.context(), emitter(conditions), file_path);
+}
+
+std::string cnf_file_name(const std::string& stem, const GenerationOptions& options) {
+    const std::string name = stem + (options.binary ? ".bcnf" : ".cnf");
+    return options.compression.empty() ? name : name + "." + options.compression;
+}
+
+namespace {
+
+// Reads a binary CNF file through a fixed-size buffer
+class BinaryReader {
+private:
+    std::ifstream stream;
+    std::vector<char> buffer = std::vector<char>(size_t{1} << 20);
+    size_t position = 0;
+    size_t filled = 0;
+public:
+    explicit BinaryReader(const std::string& file_path) : stream(file_path, std::ios::binary) {}
+    bool is_open() const { return stream.is_open(); }
+    // Next byte, or -1 at the end of the file
+    int next() {
+        if (position == filled) {
+            stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            filled = static_cast<size_t>(stream.gcount());
+            position = 0;
+            if (filled == 0) {
+                return -1;
+            }
+        }
+        return static_cast<unsigned char>(buffer[position++]);
+    }
+    bool varint(unsigned long long& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const int byte = next();
+            if (byte < 0) {
+                return false;
+            }
+            value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
         }
+        return false;
     }
-    return result;
+};
+
 }
 
 /**
- * Class to represent the condition: input != value
- * Generates CNF clauses that enforce input to be different from a specific value
- * This is used to exclude specific values from the solution space
- * 
- * Creates a single clause that is satisfied when at least one bit differs
- * from the corresponding bit in the target value
+ * Writes the DIMACS text of a binary CNF: the usual "c" lines, the "cv" lines of the ".sym"
+ * file when it exists, the "p cnf" line and one line per clause
+ * Literals come out in the order they were stored (sorted by variable within each clause)
  */
-Input_Not_Equals_Number::Input_Not_Equals_Number(const std::string& input, int value, int n) 
-    : input(input), value(value), n(n) {}
-
-std::string Input_Not_Equals_Number::expand() const {
-    std::ostringstream result;
-    for (int i = 0; i < n; ++i) {
-        if (((value >> i) & 1) == 1) {
-            result << "-<" << input << "_" << Z(i) << "> ";
-        } else {
-            result << "<" << input << "_" << Z(i) << "> ";
+bool binary_cnf_to_dimacs(const std::string& binary_path, const std::string& dimacs_path) {
+    BinaryReader reader(binary_path);
+    if (!reader.is_open()) {
+        std::cerr << "Error: Could not open file " << binary_path << std::endl;
+        return false;
+    }
+    unsigned long long version = 0, variables = 0, clauses = 0;
+    bool valid = reader.next() == 'B' && reader.next() == 'C' && reader.next() == 'N' && reader.next() == 'F';
+    valid = valid && reader.varint(version) && version == 1 && reader.varint(variables) && reader.varint(clauses);
+    if (!valid) {
+        std::cerr << "Error: " << binary_path << " is not a binary CNF file" << std::endl;
+        return false;
+    }
+    
+    BackgroundFileBuffer output(dimacs_path);
+    if (!output.is_open()) {
+        std::cerr << "Error: Could not open file " << dimacs_path << " for writing" << std::endl;
+        return false;
+    }
+    std::ostream file(&output);
+    file << "c\n";
+    file << "c\n";
+    file << "c\n";
+    std::ifstream symbols(binary_path + ".sym");
+    file << symbols.rdbuf();
+    file.clear();
+    file << "p cnf " << variables << " " << clauses << "\n";
+    
+    char text[32];
+    for (unsigned long long i = 0; i < clauses && valid; ++i) {
+        unsigned long long length = 0, code = 0, variable = 0;
+        valid = reader.varint(length);
+        for (unsigned long long j = 0; j < length && valid; ++j) {
+            valid = reader.varint(code);
+            variable += code >> 1;
+            const long long literal = (code & 1) ? -static_cast<long long>(variable) : static_cast<long long>(variable);
+            char* end = std::to_chars(text, text + sizeof(text), literal).ptr;
+            *end++ = ' ';
+            file.write(text, end - text);
         }
+        file.write("0\n", 2);
+    }
+    if (!valid || reader.next() != -1) {
+        std::cerr << "Error: " << binary_path << " is truncated or malformed" << std::endl;
+        output.close();
+        return false;
+    }
+    if (!output.close()) {
+        std::cerr << "Error: Could not write file " << dimacs_path << std::endl;
+        return false;
     }
-    result << " 0 ";
-    return result.str();
+    return true;
 }
 
-/**
- * Class to represent carry-out logic for 1-bit addition
- * carry_out == (popcount(in_a, in_b, carry_in) >= 2)
- * This implements the carry generation logic for binary addition
- * 
- * The carry-out is 1 when at least 2 of the 3 inputs (a, b, carry_in) are 1
- * This is equivalent to checking if the population count (number of 1s) is >= 2
- */
-CarryOut_Equal_POPCNT_GREATER_THAN_2::CarryOut_Equal_POPCNT_GREATER_THAN_2(
-    const std::string& in_a, const std::string& in_b, 
-    const std::string& carry_in, const std::string& carry_out)
-    : in_a(in_a), in_b(in_b), carry_in(carry_in), carry_out(carry_out) {}
-
-std::vector<std::string> CarryOut_Equal_POPCNT_GREATER_THAN_2::expand() const {
-    std::vector<std::string> result;
-    result.push_back("-<" + in_a + "> -<" + in_b + "> -<" + carry_in + ">  <" + carry_out + "> 0 ");
-    result.push_back("-<" + in_a + "> -<" + in_b + ">  <" + carry_in + ">  <" + carry_out + "> 0 ");
-    result.push_back("-<" + in_a + ">  <" + in_b + "> -<" + carry_in + ">  <" + carry_out + "> 0 ");
-    result.push_back("-<" + in_a + ">  <" + in_b + ">  <" + carry_in + "> -<" + carry_out + "> 0 ");
-    result.push_back(" <" + in_a + "> -<" + in_b + "> -<" + carry_in + ">  <" + carry_out + "> 0 ");
-    result.push_back(" <" + in_a + "> -<" + in_b + ">  <" + carry_in + "> -<" + carry_out + "> 0 ");
-    result.push_back(" <" + in_a + ">  <" + in_b + "> -<" + carry_in + "> -<" + carry_out + "> 0 ");
-    result.push_back(" <" + in_a + ">  <" + in_b + ">  <" + carry_in + "> -<" + carry_out + "> 0 ");
-    return result;
+bool SymbolMap::open(const std::string& file_path) {
+    close();
+    const int descriptor = ::open(file_path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < 32) {
+        ::close(descriptor);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const char*>(mapped);
+    length = static_cast<size_t>(status.st_size);
+    
+    unsigned long long header[4];
+    std::memcpy(header, data, sizeof(header));
+    bool valid = std::memcmp(data, "CNFSYM1", 8) == 0
+        && header[2] % 8 == 0 && header[2] >= 32 && header[2] <= length
+        && header[1] <= (length - header[2]) / sizeof(Entry)
+        && header[3] == header[2] + header[1] * sizeof(Entry)
+        && header[1] * sizeof(unsigned int) <= length - header[3];
+    if (valid) {
+        count = static_cast<size_t>(header[1]);
+        entries = reinterpret_cast<const Entry*>(data + header[2]);
+        by_id = reinterpret_cast<const unsigned int*>(data + header[3]);
+        names = data + 32;
+        // Every name must lie in the names region and every index must name an entry,
+        // so the lookups never read outside the mapping
+        const unsigned long long names_length = header[2] - 32;
+        for (size_t i = 0; valid && i < count; ++i) {
+            valid = entries[i].name_offset <= names_length
+                && entries[i].name_length <= names_length - entries[i].name_offset
+                && by_id[i] < count;
+        }
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+    return true;
 }
 
-/**
- * Class to represent result logic for 1-bit addition
- * result == in_a XOR in_b XOR carry_in
- * This implements the sum generation logic for binary addition
- * 
- * The result is 1 when an odd number of inputs (a, b, carry_in) are 1
- * This is equivalent to the XOR of all three inputs
- */
-Result_Equal_A_XOR_B_XOR_CarryIn::Result_Equal_A_XOR_B_XOR_CarryIn(
-    const std::string& in_a, const std::string& in_b, 
-    const std::string& carry_in, const std::string& result)
-    : in_a(in_a), in_b(in_b), carry_in(carry_in), result(result) {}
+void SymbolMap::close() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), length);
+    }
+    data = names = nullptr;
+    entries = nullptr;
+    by_id = nullptr;
+    length = count = 0;
+}
 
-std::vector<std::string> Result_Equal_A_XOR_B_XOR_CarryIn::expand() const {
-    std::vector<std::string> cnf_clauses;
-    cnf_clauses.push_back("-<" + in_a + "> -<" + in_b + "> -<" + carry_in + ">  <" + result + "> 0 ");
-    cnf_clauses.push_back("-<" + in_a + "> -<" + in_b + ">  <" + carry_in + "> -<" + result + "> 0 ");
-    cnf_clauses.push_back("-<" + in_a + ">  <" + in_b + "> -<" + carry_in + "> -<" + result + "> 0 ");
-    cnf_clauses.push_back("-<" + in_a + ">  <" + in_b + ">  <" + carry_in + ">  <" + result + "> 0 ");
-    cnf_clauses.push_back(" <" + in_a + "> -<" + in_b + "> -<" + carry_in + "> -<" + result + "> 0 ");
-    cnf_clauses.push_back(" <" + in_a + "> -<" + in_b + ">  <" + carry_in + ">  <" + result + "> 0 ");
-    cnf_clauses.push_back(" <" + in_a + ">  <" + in_b + "> -<" + carry_in + ">  <" + result + "> 0 ");
-    cnf_clauses.push_back(" <" + in_a + ">  <" + in_b + ">  <" + carry_in + "> -<" + result + "> 0 ");
-    return cnf_clauses;
+int SymbolMap::id(std::string_view name) const {
+    size_t low = 0, high = count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (compare_symbol_names(name_at(middle), name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < count && name_at(low) == name) ? entries[low].id : 0;
 }
 
-/**
- * Class to represent 1-bit addition: in_a + in_b + carry_in == (result, carry_out)
- * Combines carry generation and sum generation logic into a complete 1-bit adder
- * 
- * This is the fundamental building block for multi-bit addition operations
- * It generates all necessary CNF clauses to ensure correct addition behavior
- */
-Add_1Bit::Add_1Bit(const std::string& in_a, const std::string& in_b, 
-                   const std::string& carry_in, const std::string& result, const std::string& carry_out)
-    : in_a(in_a), in_b(in_b), carry_in(carry_in), result(result), carry_out(carry_out) {}
+std::string_view SymbolMap::name(int id) const {
+    size_t low = 0, high = count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (entries[by_id[middle]].id < id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < count && entries[by_id[low]].id == id) ? name_at(by_id[low]) : std::string_view();
+}
 
-std::vector<std::string> Add_1Bit::expand() const {
-    std::vector<std::string> result_clauses;
-    
-    // Generate carry-out constraints
-    CarryOut_Equal_POPCNT_GREATER_THAN_2 carry_out_constraint(in_a, in_b, carry_in, carry_out);
-    auto carry_out_clauses = carry_out_constraint.expand();
-    result_clauses.insert(result_clauses.end(), carry_out_clauses.begin(), carry_out_clauses.end());
+namespace {
 
-    // Generate result constraints
-    Result_Equal_A_XOR_B_XOR_CarryIn result_constraint(in_a, in_b, carry_in, result);
-    auto result_xor_clauses = result_constraint.expand();
-    result_clauses.insert(result_clauses.end(), result_xor_clauses.begin(), result_xor_clauses.end());
-    
-    return result_clauses;
+// Characters allowed inside a "<name>" symbol
+bool is_symbol_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
 }
 
-// Static member variable for tracking call counts
-int Add_NBit::call_count = 0;
-
 /**
- * Class to represent N-bit addition: in_a + in_b == result
- * Implements ripple-carry addition using multiple 1-bit adders
- * 
- * This creates a chain of 1-bit adders where the carry-out of each stage
- * becomes the carry-in of the next stage, implementing standard binary addition
+ * Finds the next "<name>" symbol in text at or after from (the symbols the
+ * regex <[a-zA-Z0-9_]+> matches); returns false when there is none
  */
-Add_NBit::Add_NBit(const std::string& in_a, const std::string& in_b, 
-                   const std::string& result, const std::string& over_flow, int n)
-    : in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
-
-std::vector<std::string> Add_NBit::expand() const {
-    std::vector<std::string> result_clauses;
-    
-    ++call_count;
-    
-    // Initialize carry-in to 0 for the first bit
-    result_clauses.push_back("-<AddNBit_" + Z(call_count) + "_carry_out_" + Z(0) + "> 0 ");
-    
-    // Chain 1-bit adders for each bit position
-    for (int i = 0; i < n; ++i) {
-        Add_1Bit add_1bit(
-            in_a + "_" + Z(i),
-            in_b + "_" + Z(i),
-            "AddNBit_" + Z(call_count) + "_carry_out_" + Z(i),
-            result + "_" + Z(i),
-            "AddNBit_" + Z(call_count) + "_carry_out_" + Z(i + 1)
-        );
-        auto add_clauses = add_1bit.expand();
-        result_clauses.insert(result_clauses.end(), add_clauses.begin(), add_clauses.end());
+bool next_symbol(std::string_view text, size_t from, size_t& begin, size_t& end) {
+    for (size_t open = text.find('<', from); open != std::string_view::npos; open = text.find('<', open + 1)) {
+        size_t close = open + 1;
+        while (close < text.size() && is_symbol_char(text[close])) {
+            ++close;
+        }
+        if (close < text.size() && text[close] == '>' && close > open + 1) {
+            begin = open;
+            end = close + 1;
+            return true;
+        }
     }
-    
-    // Connect overflow to the final carry-out
-    result_clauses.push_back("-<" + over_flow + ">  <AddNBit_" + Z(call_count) + "_carry_out_" + Z(n) + "> 0 ");
-    result_clauses.push_back(" <" + over_flow + "> -<AddNBit_" + Z(call_count) + "_carry_out_" + Z(n) + "> 0 ");
-    
-    return result_clauses;
+    return false;
 }
 
-// Static member variable for tracking call counts
-int Mul_NBit_1Bit_Shift::call_count = 0;
-
 /**
- * Class to represent multiplication with shift: (in_a * in_b) << shift == result
- * Implements multiplication of N-bit number by 1-bit with left shift
- * 
- * This is a building block for full multiplication, implementing the partial product
- * generation step where each bit of the multiplier is ANDed with the multiplicand
- * and shifted to the appropriate position
+ * Open-addressing (linear probing) map from "<name>" symbols to ids
+ * Keys are views into the caller's clause strings, which must outlive the table
  */
-Mul_NBit_1Bit_Shift::Mul_NBit_1Bit_Shift(const std::string& in_a, const std::string& in_b, 
-                                         const std::string& result, int shift, int n)
-    : in_a(in_a), in_b(in_b), result(result), shift(shift), n(n) {}
+class SymbolTable {
+private:
+    struct Slot {
+        std::string_view key;
+        int id = 0;
+        bool used = false;
+    };
+    std::vector<Slot> slots = std::vector<Slot>(1024);
+    std::vector<std::string_view> keys;
 
-std::vector<std::string> Mul_NBit_1Bit_Shift::expand() const {
-    std::vector<std::string> result_clauses;
-    
-    // Set lower bits to 0 (shift effect)
-    for (int i = 0; i < shift; ++i) {
-        result_clauses.push_back("-<" + result + "_" + Z(i) + "> 0 ");
+    static size_t hash(std::string_view key) {
+        unsigned long long state = 14695981039346656037ULL;
+        for (char c : key) {
+            state ^= static_cast<unsigned char>(c);
+            state *= 1099511628211ULL;
+        }
+        return static_cast<size_t>(state ^ (state >> 29));
     }
-    
-    // For each bit position, implement AND logic with shift
-    for (int i = 0; i < n; ++i) {
-        // result[i+shift] = in_a[i] AND in_b
-        result_clauses.push_back(" <" + result + "_" + Z(i + shift) + "> -<" + in_a + "_" + Z(i) + "> -<" + in_b + "> 0 ");
-        result_clauses.push_back("-<" + result + "_" + Z(i + shift) + "> -<" + in_a + "_" + Z(i) + ">  <" + in_b + "> 0 ");
-        result_clauses.push_back("-<" + result + "_" + Z(i + shift) + ">  <" + in_a + "_" + Z(i) + "> -<" + in_b + "> 0 ");
-        result_clauses.push_back("-<" + result + "_" + Z(i + shift) + ">  <" + in_a + "_" + Z(i) + ">  <" + in_b + "> 0 ");
+    size_t probe(std::string_view key) const {
+        const size_t mask = slots.size() - 1;
+        size_t i = hash(key) & mask;
+        while (slots[i].used && slots[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return i;
     }
-    
-    // Set upper bits beyond result range to 0
-    for (int i = shift + n; i < n * 2; ++i) {
-        result_clauses.push_back("-<" + result + "_" + Z(i) + "> 0 ");
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        for (const Slot& slot : old) {
+            if (slot.used) {
+                slots[probe(slot.key)] = slot;
+            }
+        }
     }
-    
-    return result_clauses;
-}
+public:
+    void insert(std::string_view key) {
+        size_t i = probe(key);
+        if (slots[i].used) {
+            return;
+        }
+        if ((keys.size() + 1) * 2 > slots.size()) {
+            grow();
+            i = probe(key);
+        }
+        slots[i].key = key;
+        slots[i].used = true;
+        keys.push_back(key);
+    }
+    void set_id(std::string_view key, int id) { slots[probe(key)].id = id; }
+    int id(std::string_view key) const { return slots[probe(key)].id; }
+    // Distinct keys in insertion order
+    const std::vector<std::string_view>& symbols() const { return keys; }
+    size_t size() const { return keys.size(); }
+};
 
-// Static member variable for tracking call counts
-int Mul_NBit::call_count = 0;
+// Per-thread buffers of the radix sort
+struct RadixScratch {
+    std::vector<std::string_view> names;
+    std::vector<unsigned short> buckets;
+};
 
 /**
- * Class to represent N-bit multiplication: in_a * in_b == result
- * Implements multiplication using shift-and-add algorithm
+ * One MSD radix pass over names[first, last): skips the bytes all names share from depth on,
+ * then distributes the names by their byte at the first differing depth into buckets 1..256,
+ * names that end there into bucket 0 (so a prefix sorts first); bucket k ends up in
+ * names[starts[k], starts[k + 1]). Returns the depth of the distributing byte
  */
-Mul_NBit::Mul_NBit(const std::string& in_a, const std::string& in_b, 
-                   const std::string& result, const std::string& over_flow, int n)
-    : in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
-
-std::vector<std::string> Mul_NBit::expand() const {
-    std::vector<std::string> result_clauses;
-    
-    ++call_count;
-    
-    // Generate partial products for each bit of in_b
-    for (int i = 0; i < n; ++i) {
-        Mul_NBit_1Bit_Shift mul_shift(
-            in_a,
-            in_b + "_" + Z(i),
-            "Mul_NBit_Accum1_" + Z(call_count) + "_" + Z(i),
-            i,
-            n
-        );
-        auto mul_clauses = mul_shift.expand();
-        result_clauses.insert(result_clauses.end(), mul_clauses.begin(), mul_clauses.end());
-    }
-
-    // Initialize accumulator to 0
-    for (int i = 0; i < n * 2; ++i) {
-        result_clauses.push_back("-<Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(0) + "_" + Z(i) + "> 0 ");
+size_t distribute_names(std::string_view* names, size_t first, size_t last, size_t depth,
+                        RadixScratch& scratch, size_t (&starts)[258]) {
+    const auto bucket_of = [](std::string_view name, size_t at) -> size_t {
+        return name.size() > at ? static_cast<unsigned char>(name[at]) + 1 : 0;
+    };
+    std::vector<unsigned short>& buckets = scratch.buckets;
+    buckets.resize(last - first);
+    for (;; ++depth) {
+        std::fill(std::begin(starts), std::end(starts), size_t{0});
+        for (size_t i = first; i < last; ++i) {
+            buckets[i - first] = static_cast<unsigned short>(bucket_of(names[i], depth));
+            ++starts[buckets[i - first] + 1];
+        }
+        if (buckets[0] == 0 || starts[buckets[0] + 1] != last - first) {
+            break;
+        }
     }
-    
-    // Add partial products to accumulator
-    for (int i = 0; i < n; ++i) {
-        Add_NBit add_nbit(
-            "Mul_NBit_Accum1_" + Z(call_count) + "_" + Z(i),
-            "Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(i),
-            "Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(i + 1),
-            "Mul_NBit_CarryOut_" + Z(call_count) + "_" + Z(i),
-            n * 2
-        );
-        auto add_clauses = add_nbit.expand();
-        result_clauses.insert(result_clauses.end(), add_clauses.begin(), add_clauses.end());
+    starts[0] = first;
+    for (size_t k = 1; k < 258; ++k) {
+        starts[k] += starts[k - 1];
     }
-    
-    // Connect result to final accumulator value
-    for (int i = 0; i < n; ++i) {
-        result_clauses.push_back("-<" + result + "_" + Z(i) + ">  <Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(n) + "_" + Z(i) + "> 0 ");
-        result_clauses.push_back(" <" + result + "_" + Z(i) + "> -<Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(n) + "_" + Z(i) + "> 0 ");
+    size_t fill[257];
+    std::copy(std::begin(starts), std::begin(starts) + 257, fill);
+    scratch.names.resize(last - first);
+    for (size_t i = first; i < last; ++i) {
+        scratch.names[fill[buckets[i - first]]++ - first] = names[i];
     }
-    
-    // Generate overflow condition: if any upper bits are set, overflow occurs
-    std::ostringstream overflow_clause;
-    overflow_clause << "-<" << over_flow << "> ";
-    for (int i = 0; i < n; ++i) {
-        overflow_clause << " <Mul_NBit_Accum2_" << Z(call_count) << "_" << Z(n) << "_" << Z(i + n) << "> ";
+    std::copy(scratch.names.begin(), scratch.names.end(), names + first);
+    return depth;
+}
+
+// Sorts names[first, last), which agree on their first depth bytes, into byte order
+void radix_sort_names(std::string_view* names, size_t first, size_t last, size_t depth,
+                      RadixScratch& scratch) {
+    if (last - first < 64) {
+        std::sort(names + first, names + last, [depth](std::string_view a, std::string_view b) {
+            return a.substr(depth) < b.substr(depth);
+        });
+        return;
     }
-    overflow_clause << " 0 ";
-    result_clauses.push_back(overflow_clause.str());
-    
-    // If overflow is set, at least one upper bit must be set
-    for (int i = 0; i < n; ++i) {
-        result_clauses.push_back("<" + over_flow + ">  -<Mul_NBit_Accum2_" + Z(call_count) + "_" + Z(n) + "_" + Z(i + n) + "> 0 ");
+    size_t starts[258];
+    depth = distribute_names(names, first, last, depth, scratch, starts);
+    for (size_t k = 1; k < 257; ++k) {
+        if (starts[k + 1] - starts[k] > 1) {
+            radix_sort_names(names, starts[k], starts[k + 1], depth + 1, scratch);
+        }
     }
-    
-    return result_clauses;
 }
 
-class ExpandableCondition {
-public:
-    virtual ~ExpandableCondition() = default;
-    virtual std::vector<std::string> expand() const = 0;
-};
-
-
-class StringCondition : public ExpandableCondition {
-private:
-    std::string condition;
-public:
-    StringCondition(const std::string& cond) : condition(cond) {}
-    std::vector<std::string> expand() const override {
-        return {condition};
+/**
+ * Sorts distinct names into byte order (the order of std::string_view's operator<) with an MSD
+ * radix sort: the first distributing pass runs on the calling thread, then the workers take the
+ * resulting buckets, largest first, and sort each one on its own
+ */
+void radix_sort_names(std::vector<std::string_view>& names, unsigned workers) {
+    if (names.size() < 2) {
+        return;
     }
-};
-
-void generate_cnf(const std::vector<std::string>& conditions, const std::string& file_path) {
-    std::vector<std::string> expanded_conditions = conditions;
-    
-    bool changed = true;
-    int iter = 0;
-    while (changed) {
-        iter++;
-        changed = false;
-        std::cerr << "expand : " << iter << std::endl;
-        
-        std::vector<std::string> new_conditions;
-        for (const auto& condition : expanded_conditions) {
-            new_conditions.push_back(condition);
+    RadixScratch scratch;
+    size_t starts[258];
+    const size_t depth = distribute_names(names.data(), 0, names.size(), 0, scratch, starts);
+    std::vector<std::pair<size_t, size_t>> buckets;
+    for (size_t k = 1; k < 257; ++k) {
+        if (starts[k + 1] - starts[k] > 1) {
+            buckets.emplace_back(starts[k], starts[k + 1]);
         }
-        expanded_conditions = new_conditions;
     }
+    std::sort(buckets.begin(), buckets.end(), [](const auto& a, const auto& b) {
+        return a.second - a.first > b.second - b.first;
+    });
+    std::atomic<size_t> next{0};
+    parallel_chunks(workers, workers, [&](unsigned, size_t, size_t) {
+        RadixScratch own;
+        for (size_t b = next++; b < buckets.size(); b = next++) {
+            radix_sort_names(names.data(), buckets[b].first, buckets[b].second, depth + 1, own);
+        }
+    });
+}
+
+}
+
+/**
+ * Writes "<name>"-style string clauses as a DIMACS CNF file
+ * Each clause is scanned once per pass by next_symbol(): the first pass collects the names
+ * into a SymbolTable, the second copies the clause into an output buffer with every name
+ * replaced by its id. The names are put in byte order once by radix_sort_names(); the "cv"
+ * lines follow that order and the ids the same order with uppercase names moved last
+ *
+ * Both passes split the clauses into contiguous chunks, one per worker thread: each worker
+ * gathers names into its own table (merged afterwards, names are sorted anyway) and rewrites
+ * its chunk into its own buffer; buffers are written in chunk order, so the file does not
+ * depend on the number of threads. Progress is reported for the first chunk
+ */
+void generate_cnf(const std::vector<std::string>& conditions, const std::string& file_path,
+                  const GenerationOptions& options) {
+    const std::vector<std::string>& expanded_conditions = conditions;
+    const unsigned workers = worker_count(options.threads, expanded_conditions.size());
+    const size_t step = std::max<size_t>(1, expanded_conditions.size() / workers / 20);
     
     std::cerr << "gather literals..." << std::endl;
-    std::set<std::string> literals_set;
-    
-    std::regex literal_regex(R"(<[a-zA-Z0-9_]+>)");
-    for (size_t i = 0; i < expanded_conditions.size(); ++i) {
-        if ((i % (expanded_conditions.size() / 20)) == 0) {
-            std::cerr << (5 * i / (expanded_conditions.size() / 20)) << "%..." << std::endl;
+    std::vector<SymbolTable> gathered(workers);
+    parallel_chunks(workers, expanded_conditions.size(), [&](unsigned worker, size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (worker == 0 && (i % step) == 0) {
+                std::cerr << (5 * i / step) << "%..." << std::endl;
+            }
+            
+            const std::string_view clause = expanded_conditions[i];
+            size_t begin = 0, end = 0;
+            while (next_symbol(clause, end, begin, end)) {
+                gathered[worker].insert(clause.substr(begin, end - begin));
+            }
         }
-        
-        std::string clause = expanded_conditions[i];
-        std::sregex_iterator it(clause.begin(), clause.end(), literal_regex);
-        std::sregex_iterator end;
-        for (; it != end; ++it) {
-            literals_set.insert(it->str());
+    });
+    SymbolTable& symbols = gathered[0];
+    for (unsigned w = 1; w < workers; ++w) {
+        for (std::string_view symbol : gathered[w].symbols()) {
+            symbols.insert(symbol);
         }
     }
     
     std::cerr << "sorting literals..." << std::endl;
-    std::vector<std::string> literals(literals_set.begin(), literals_set.end());
-    
-    std::sort(literals.begin(), literals.end(), [](const std::string& a, const std::string& b) {
-        bool a_upper = (a[1] >= 'A' && a[1] <= 'Z');
-        bool b_upper = (b[1] >= 'A' && b[1] <= 'Z');
-        
-        if (a_upper && b_upper) {
-            return a < b;
-        } else if (!a_upper && !b_upper) {
-            return a < b;
-        } else if (a_upper && !b_upper) {
-            return false;
-        } else {
-            return true;
-        }
+    std::vector<std::string_view> by_name = symbols.symbols();
+    radix_sort_names(by_name, resolved_threads(options.threads));
+    std::vector<std::string_view> literals = by_name;
+    std::stable_partition(literals.begin(), literals.end(), [](std::string_view name) {
+        return !(name[1] >= 'A' && name[1] <= 'Z');
     });
     
     std::cerr << "mapping symbol to integer..." << std::endl;
-    std::map<std::string, int> literal_map;
     for (size_t i = 0; i < literals.size(); ++i) {
-        literal_map[literals[i]] = i + 1;
-    }
-    
-    std::cerr << "replacing symbol to integer..." << std::endl;
-    std::vector<std::string> replaced;
-    for (size_t iter = 0; iter < expanded_conditions.size(); ++iter) {
-        if ((iter % (expanded_conditions.size() / 20)) == 0) {
-            std::cerr << (5 * iter / (expanded_conditions.size() / 20)) << "%..." << std::endl;
-        }
-        
-        std::string clause = expanded_conditions[iter];
-        
-        // Extract literals that appear in this clause only
-        std::sregex_iterator it(clause.begin(), clause.end(), literal_regex);
-        std::sregex_iterator end;
-        std::set<std::string> clause_literals;
-        for (; it != end; ++it) {
-            clause_literals.insert(it->str());
-        }
-        
-        // Replace only the literals that appear in this clause
-        for (const auto& literal : clause_literals) {
-            size_t pos = 0;
-            while ((pos = clause.find(literal, pos)) != std::string::npos) {
-                clause.replace(pos, literal.length(), std::to_string(literal_map[literal]));
-                pos += std::to_string(literal_map[literal]).length();
-            }
-        }
-        replaced.push_back(clause);
+        symbols.set_id(literals[i], static_cast<int>(i + 1));
     }
     
     std::cerr << "writing cnf to file..." << std::endl;
-    std::ofstream file(file_path);
-    if (!file.is_open()) {
+    BackgroundFileBuffer output(file_path, options.threads);
+    if (!output.is_open()) {
         std::cerr << "Error: Could not open file " << file_path << " for writing" << std::endl;
         return;
     }
+    std::ostream file(&output);
     
     file << "c\n";
     file << "c\n";
     file << "c\n";
     
-    for (const auto& [literal, value] : literal_map) {
-        file << "cv " << literal << " " << value << "\n";
+    for (std::string_view literal : by_name) {
+        file << "cv " << literal << " " << symbols.id(literal) << "\n";
     }
     
-    file << "p cnf " << literal_map.size() << " " << replaced.size() << "\n";
+    file << "p cnf " << symbols.size() << " " << expanded_conditions.size() << "\n";
     
-    for (size_t i = 0; i < replaced.size(); ++i) {
-        if ((i % (replaced.size() / 20)) == 0) {
-            std::cerr << (5 * i / (replaced.size() / 20)) << "%..." << std::endl;
+    // With several workers (and no compression) the header is closed and each block's buffers
+    // are written with pwrite
+    const bool positional_write = workers > 1 && !output.compressed();
+    size_t offset = output.size();
+    if (positional_write && !output.close()) {
+        std::cerr << "Error: Could not write file " << file_path << std::endl;
+        return;
+    }
+    PositionalFile positional(positional_write ? file_path : std::string());
+    
+    // The clauses are rewritten block by block and each block is written before the next one
+    // starts, so only one block of text is held in memory at a time
+    std::cerr << "replacing symbol to integer..." << std::endl;
+    const size_t block_size = size_t{65536} * workers;
+    const size_t write_step = std::max<size_t>(1, expanded_conditions.size() / 20);
+    std::vector<std::string> replaced(workers);
+    size_t next_report = 0;
+    for (size_t block_first = 0; block_first < expanded_conditions.size(); block_first += block_size) {
+        const size_t block_last = std::min(expanded_conditions.size(), block_first + block_size);
+        parallel_chunks(workers, block_last - block_first, [&](unsigned worker, size_t first, size_t last) {
+            std::string& buffer = replaced[worker];
+            buffer.clear();
+            char digits[16];
+            for (size_t iter = block_first + first; iter < block_first + last; ++iter) {
+                const std::string_view clause = expanded_conditions[iter];
+                size_t copied = 0, begin = 0, end = 0;
+                while (next_symbol(clause, end, begin, end)) {
+                    buffer.append(clause.substr(copied, begin - copied));
+                    const int id = symbols.id(clause.substr(begin, end - begin));
+                    buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), id).ptr);
+                    copied = end;
+                }
+                buffer.append(clause.substr(copied));
+                buffer.push_back('\n');
+            }
+        });
+        if (positional_write) {
+            offset = positional.write_in_order(replaced, offset);
+        } else {
+            for (const std::string& buffer : replaced) {
+                file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+        }
+        for (; next_report < block_last; next_report += write_step) {
+            std::cerr << (5 * next_report / write_step) << "%..." << std::endl;
         }
-        file << replaced[i] << "\n";
     }
     
-    file.close();
+    if (!(positional_write ? positional.close() : output.close())) {
+        std::cerr << "Error: Could not write file " << file_path << std::endl;
+        return;
+    }
     std::cerr << "CNF file generated successfully: " << file_path << std::endl;
 }
 
 // Static member variable definition for IsPrime
-int IsPrime::call_count = 0;
 
 /**
  * Class to represent primality testing: target is a prime number
  * Implements comprehensive primality testing using multiple Fermat tests and mathematical constraints
  */
-IsPrime::IsPrime(const std::string& target, int n, int num_prime)
-    : target(target), n(n), num_prime(num_prime == -1 ? n : num_prime) {}
+IsPrime::IsPrime(GenerationContext& context, const Sym& target, int n, int num_prime)
+    : context(context), target(target), n(n), num_prime(num_prime == -1 ? n : num_prime) {}
 
-std::vector<std::string> IsPrime::expand() const {
-//    static int call_count = 0;
-    call_count++;
+void IsPrime::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<IsPrime>();
     
-    std::vector<std::string> clauses;
     
     // Input_Not_Equals_Number for prime[i] != 0
     for (int i = 0; i < num_prime; i++) {
-        auto not_zero_clause = Input_Not_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 0, n).expand();
-        clauses.push_back(not_zero_clause);
+        Input_Not_Equals_Number(context, context.sym("IsPrime_Prime")[call_count][i], 0, n).expand(out);
     }
     
     // Input_Not_Equals_Number for prime[i] != 1
     for (int i = 0; i < num_prime; i++) {
-        auto not_one_clause = Input_Not_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 1, n).expand();
-        clauses.push_back(not_one_clause);
+        Input_Not_Equals_Number(context, context.sym("IsPrime_Prime")[call_count][i], 1, n).expand(out);
     }
     
     // Pow_NBit for pow_temp[i][j] = pow(prime[j], pow[i][j])
     for (int i = 0; i < num_prime; i++) {
         for (int j = 0; j < num_prime; j++) {
-            Pow_NBit pow_op("IsPrime_Prime_" + Z(call_count) + "_" + Z(j),
-                           "IsPrime_Pow_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
-                           "IsPrime_PowTemp_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
-                           "IsPrime_PowTemp_Overflow_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
+            Pow_NBit pow_op(context, context.sym("IsPrime_Prime")[call_count][j],
+                           context.sym("IsPrime_Pow")[call_count][i][j],
+                           context.sym("IsPrime_PowTemp")[call_count][i][j],
+                           context.sym("IsPrime_PowTemp_Overflow")[call_count][i][j],
                            n);
-            auto pow_clauses = pow_op.expand();
-            clauses.insert(clauses.end(), pow_clauses.begin(), pow_clauses.end());
+            pow_op.expand(out);
         }
     }
     
     // powtemp_overflow = 0
     for (int i = 0; i < num_prime; i++) {
         for (int j = 0; j < num_prime; j++) {
-            clauses.push_back("-<IsPrime_PowTemp_Overflow_" + Z(call_count) + "_" + Z(i) + "_" + Z(j) + "> 0 ");
+            out.add({-var(context.sym("IsPrime_PowTemp_Overflow")[call_count][i][j])});
         }
     }
     
     // Product_NBit for product[i] = product j (pow_temp[i][j])
     for (int i = 0; i < num_prime; i++) {
-        Product_NBit product_op("IsPrime_PowTemp_" + Z(call_count) + "_" + Z(i),
-                               "IsPrime_Product_" + Z(call_count) + "_" + Z(i),
-                               "IsPrime_Product_Overflow_" + Z(call_count) + "_" + Z(i),
+        Product_NBit product_op(context, context.sym("IsPrime_PowTemp")[call_count][i],
+                               context.sym("IsPrime_Product")[call_count][i],
+                               context.sym("IsPrime_Product_Overflow")[call_count][i],
                                num_prime,
                                n);
-        auto product_clauses = product_op.expand();
-        clauses.insert(clauses.end(), product_clauses.begin(), product_clauses.end());
+        product_op.expand(out);
     }
     
     // product_overflow = 0
     for (int i = 0; i < num_prime; i++) {
-        clauses.push_back("-<IsPrime_Product_Overflow_" + Z(call_count) + "_" + Z(i) + "> 0 ");
+        out.add({-var(context.sym("IsPrime_Product_Overflow")[call_count][i])});
     }
     
-    // Add_NBit for product_plus1[i] = product[i] + 1
+    // Inc_NBit for product_plus1[i] = product[i] + 1
     for (int i = 0; i < num_prime; i++) {
-        Add_NBit add_op("IsPrime_Product_" + Z(call_count) + "_" + Z(i),
-                        "One_NBit_" + Z(n),
-                        "IsPrime_Product_Plus1_" + Z(call_count) + "_" + Z(i),
-                        "IsPrime_Product_Plus1_Overflow_" + Z(call_count) + "_" + Z(i),
+        Inc_NBit inc_op(context, context.sym("IsPrime_Product")[call_count][i],
+                        context.sym("IsPrime_Product_Plus1")[call_count][i],
+                        context.sym("IsPrime_Product_Plus1_Overflow")[call_count][i],
                         n);
-        auto add_clauses = add_op.expand();
-        clauses.insert(clauses.end(), add_clauses.begin(), add_clauses.end());
+        inc_op.expand(out);
     }
     
     // product_plus1_overflow[i] = 0
     for (int i = 0; i < num_prime; i++) {
-        clauses.push_back("-<IsPrime_Product_Plus1_Overflow_" + Z(call_count) + "_" + Z(i) + "> 0 ");
+        out.add({-var(context.sym("IsPrime_Product_Plus1_Overflow")[call_count][i])});
     }
     
     // Sum_NBit for sumpow[i] = sum j pow[i][j]
     for (int i = 0; i < num_prime; i++) {
-        Sum_NBit sum_op("IsPrime_Pow_" + Z(call_count) + "_" + Z(i),
-                        "IsPrime_SumPow_" + Z(call_count) + "_" + Z(i),
-                        "IsPrime_SumPow_Overflow_" + Z(call_count) + "_" + Z(i),
+        Sum_NBit sum_op(context, context.sym("IsPrime_Pow")[call_count][i],
+                        context.sym("IsPrime_SumPow")[call_count][i],
+                        context.sym("IsPrime_SumPow_Overflow")[call_count][i],
                         num_prime,
                         n);
-        auto sum_clauses = sum_op.expand();
-        clauses.insert(clauses.end(), sum_clauses.begin(), sum_clauses.end());
+        sum_op.expand(out);
     }
     
     // sumpow_overflow[i] = 0
     for (int i = 0; i < num_prime; i++) {
-        clauses.push_back("-<IsPrime_SumPow_Overflow_" + Z(call_count) + "_" + Z(i) + "> 0 ");
+        out.add({-var(context.sym("IsPrime_SumPow_Overflow")[call_count][i])});
     }
     
     // Or_Condition for prime[i] == 2 or (1 < sumpow[i] and product_plus1[i] == prime[i])
     for (int i = 0; i < num_prime; i++) {
         // Create the inner conditions
-        std::vector<std::string> prime_equals_2 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 2, n).expand();
-        std::vector<std::string> prime_equals_3 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 3, n).expand();
+        Input_Equals_Number prime_equals_2(context, context.sym("IsPrime_Prime")[call_count][i], 2, n);
+        Input_Equals_Number prime_equals_3(context, context.sym("IsPrime_Prime")[call_count][i], 3, n);
         
         // Create the less than and equals conditions
-        LessThan_NBit less_than_op("One_NBit_" + Z(n), "IsPrime_SumPow_" + Z(call_count) + "_" + Z(i), n);
-        auto less_than_clauses = less_than_op.expand();
-        
-        Equals_NBit equals_op("IsPrime_Product_Plus1_" + Z(call_count) + "_" + Z(i),
-                             "IsPrime_Prime_" + Z(call_count) + "_" + Z(i),
+        LessThan_NBit less_than_op(context, context.sym("One_NBit")[n], context.sym("IsPrime_SumPow")[call_count][i], n);
+        Equals_NBit equals_op(context, context.sym("IsPrime_Product_Plus1")[call_count][i],
+                             context.sym("IsPrime_Prime")[call_count][i],
                              n);
-        auto equals_clauses = equals_op.expand();
         
-        // Combine conditions using Or_Condition and And_Condition
-        Or_Condition inner_or(prime_equals_2, prime_equals_3);
-        And_Condition inner_and(less_than_clauses, equals_clauses);
-        Or_Condition outer_or(inner_or.expand(), inner_and.expand());
+        // Combine conditions using Or_Condition and And_Condition; clauses stream into out
+        Or_Condition inner_or(context, emitter(prime_equals_2), emitter(prime_equals_3));
+        And_Condition inner_and(context, emitter(less_than_op), emitter(equals_op));
+        Or_Condition outer_or(context, emitter(inner_or), emitter(inner_and));
         
-        auto outer_clauses = outer_or.expand();
-        clauses.insert(clauses.end(), outer_clauses.begin(), outer_clauses.end());
+        outer_or.expand(out);
     }
     
-    // Add_NBit for prime_minus1[i] = prime[i] - 1
+    // Dec_NBit for prime_minus1[i] = prime[i] - 1
     for (int i = 0; i < num_prime; i++) {
-        Add_NBit add_op("IsPrime_Prime_Minus1_" + Z(call_count) + "_" + Z(i),
-                        "One_NBit_" + Z(n),
-                        "IsPrime_Prime_" + Z(call_count) + "_" + Z(i),
-                        "IsPrime_Prime_Minus1_Overflow_" + Z(call_count) + "_" + Z(i),
+        Dec_NBit dec_op(context, context.sym("IsPrime_Prime")[call_count][i],
+                        context.sym("IsPrime_Prime_Minus1")[call_count][i],
+                        context.sym("IsPrime_Prime_Minus1_Overflow")[call_count][i],
                         n);
-        auto add_clauses = add_op.expand();
-        clauses.insert(clauses.end(), add_clauses.begin(), add_clauses.end());
+        dec_op.expand(out);
     }
     
     // prime_minus1_overflow[i] = 0
     for (int i = 0; i < num_prime; i++) {
-        clauses.push_back("-<IsPrime_Prime_Minus1_Overflow_" + Z(call_count) + "_" + Z(i) + "> 0 ");
+        out.add({-var(context.sym("IsPrime_Prime_Minus1_Overflow")[call_count][i])});
     }
     
     // DivMod_NBit for div[i][j] = prime_minus1[i] / prime[j]
     for (int i = 0; i < num_prime; i++) {
         for (int j = 0; j < num_prime; j++) {
-            DivMod_NBit divmod_op("IsPrime_Prime_Minus1_" + Z(call_count) + "_" + Z(i),
-                                 "IsPrime_Prime_" + Z(call_count) + "_" + Z(j),
-                                 "IsPrime_Div_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
-                                 "IsPrime_Mod_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
+            DivMod_NBit divmod_op(context, context.sym("IsPrime_Prime_Minus1")[call_count][i],
+                                 context.sym("IsPrime_Prime")[call_count][j],
+                                 context.sym("IsPrime_Div")[call_count][i][j],
+                                 context.sym("IsPrime_Mod")[call_count][i][j],
                                  n);
-            auto divmod_clauses = divmod_op.expand();
-            clauses.insert(clauses.end(), divmod_clauses.begin(), divmod_clauses.end());
+            divmod_op.expand(out);
         }
     }
     
@@ -603,894 +3734,829 @@ std::vector<std::string> IsPrime::expand() const {
     for (int i = 0; i < num_prime; i++) {
         for (int j = 0; j < num_prime; j++) {
             // Create FermatTest3 condition
-            FermatTest3 fermat_op("IsPrime_Generator_" + Z(call_count) + "_" + Z(i),
-                                 "IsPrime_Div_" + Z(call_count) + "_" + Z(i) + "_" + Z(j),
-                                 "IsPrime_Prime_" + Z(call_count) + "_" + Z(i),
+            FermatTest3 fermat_op(context, context.sym("IsPrime_Generator")[call_count][i],
+                                 context.sym("IsPrime_Div")[call_count][i][j],
+                                 context.sym("IsPrime_Prime")[call_count][i],
                                  n);
-            auto fermat_clauses = fermat_op.expand();
             
             // Create pow[i][j] == 0 condition
-            std::vector<std::string> pow_zero = Input_Equals_Number("IsPrime_Pow_" + Z(call_count) + "_" + Z(i) + "_" + Z(j), 0, n).expand();
+            Input_Equals_Number pow_zero(context, context.sym("IsPrime_Pow")[call_count][i][j], 0, n);
             
             // Create prime[i] == 2 or prime[i] == 3 condition
-            std::vector<std::string> prime_equals_2 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 2, n).expand();
-            std::vector<std::string> prime_equals_3 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 3, n).expand();
+            Input_Equals_Number prime_equals_2(context, context.sym("IsPrime_Prime")[call_count][i], 2, n);
+            Input_Equals_Number prime_equals_3(context, context.sym("IsPrime_Prime")[call_count][i], 3, n);
             
             // Combine conditions
-            Or_Condition inner_or1(fermat_clauses, pow_zero);
-            Or_Condition inner_or2(prime_equals_2, prime_equals_3);
-            Or_Condition outer_or(inner_or1.expand(), inner_or2.expand());
+            Or_Condition inner_or2(context, emitter(prime_equals_2), emitter(prime_equals_3));
+            Or_Condition inner_or1(context, emitter(fermat_op), emitter(pow_zero));
+            Or_Condition outer_or(context, emitter(inner_or1), emitter(inner_or2));
             
-            auto outer_clauses = outer_or.expand();
-            clauses.insert(clauses.end(), outer_clauses.begin(), outer_clauses.end());
+            outer_or.expand(out);
         }
     }
     
     // Or_Condition for final Fermat test
     for (int i = 0; i < num_prime; i++) {
         // Create FermatTest2 condition
-        FermatTest2 fermat_op("IsPrime_Generator_" + Z(call_count) + "_" + Z(i),
-                             "IsPrime_Prime_" + Z(call_count) + "_" + Z(i),
+        FermatTest2 fermat_op(context, context.sym("IsPrime_Generator")[call_count][i],
+                             context.sym("IsPrime_Prime")[call_count][i],
                              n);
-        auto fermat_clauses = fermat_op.expand();
         
         // Create prime[i] == 2 or prime[i] == 3 condition
-        std::vector<std::string> prime_equals_2 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 2, n).expand();
-        std::vector<std::string> prime_equals_3 = Input_Equals_Number("IsPrime_Prime_" + Z(call_count) + "_" + Z(i), 3, n).expand();
+        Input_Equals_Number prime_equals_2(context, context.sym("IsPrime_Prime")[call_count][i], 2, n);
+        Input_Equals_Number prime_equals_3(context, context.sym("IsPrime_Prime")[call_count][i], 3, n);
         
         // Combine conditions
-        Or_Condition inner_or(prime_equals_2, prime_equals_3);
-        Or_Condition outer_or(fermat_clauses, inner_or.expand());
+        Or_Condition inner_or(context, emitter(prime_equals_2), emitter(prime_equals_3));
+        Or_Condition outer_or(context, emitter(fermat_op), emitter(inner_or));
         
-        auto outer_clauses = outer_or.expand();
-        clauses.insert(clauses.end(), outer_clauses.begin(), outer_clauses.end());
+        outer_or.expand(out);
     }
     
     // Equals_NBit for target == prime[0]
-    Equals_NBit target_equals_op(target, "IsPrime_Prime_" + Z(call_count) + "_" + Z(0), n);
-    auto target_clauses = target_equals_op.expand();
-    clauses.insert(clauses.end(), target_clauses.begin(), target_clauses.end());
+    Equals_NBit target_equals_op(context, target, context.sym("IsPrime_Prime")[call_count][0], n);
+    target_equals_op.expand(out);
     
-    return clauses;
 }
 
 /**
  * Class to represent composite number testing: target is a composite number
  * Implements composite number detection by finding two non-trivial factors
  */
-IsComposite::IsComposite(const std::string& target, int n)
-    : target(target), n(n) {}
+IsComposite::IsComposite(GenerationContext& context, const Sym& target, int n)
+    : context(context), target(target), n(n) {}
 
-std::vector<std::string> IsComposite::expand() const {
-    static int call_count = 0;
-    call_count++;
+void IsComposite::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<IsComposite>();
     
-    std::vector<std::string> clauses;
     
     // Mul_NBit for factor1 * factor2 = target
-    auto mul_clauses = Mul_NBit("IsComposite_fact1_" + Z(call_count),
-                               "IsComposite_fact2_" + Z(call_count),
+    Mul_NBit(context, context.sym("IsComposite_fact1")[call_count],
+                               context.sym("IsComposite_fact2")[call_count],
                                target,
-                               "IsComposite_Overflow_" + Z(call_count),
-                               n).expand();
-    clauses.insert(clauses.end(), mul_clauses.begin(), mul_clauses.end());
+                               context.sym("IsComposite_Overflow")[call_count],
+                               n).expand(out);
     
     // Input_Not_Equals_Number for factor1 != 0
-    auto fact1_not_zero_clause = Input_Not_Equals_Number("IsComposite_fact1_" + Z(call_count), 0, n).expand();
-    clauses.push_back(fact1_not_zero_clause);
+    Input_Not_Equals_Number(context, context.sym("IsComposite_fact1")[call_count], 0, n).expand(out);
     
     // Input_Not_Equals_Number for factor2 != 0
-    auto fact2_not_zero_clause = Input_Not_Equals_Number("IsComposite_fact2_" + Z(call_count), 0, n).expand();
-    clauses.push_back(fact2_not_zero_clause);
+    Input_Not_Equals_Number(context, context.sym("IsComposite_fact2")[call_count], 0, n).expand(out);
     
     // Input_Not_Equals_Number for factor1 != 1
-    auto fact1_not_one_clause = Input_Not_Equals_Number("IsComposite_fact1_" + Z(call_count), 1, n).expand();
-    clauses.push_back(fact1_not_one_clause);
+    Input_Not_Equals_Number(context, context.sym("IsComposite_fact1")[call_count], 1, n).expand(out);
     
     // Input_Not_Equals_Number for factor2 != 1
-    auto fact2_not_one_clause = Input_Not_Equals_Number("IsComposite_fact2_" + Z(call_count), 1, n).expand();
-    clauses.push_back(fact2_not_one_clause);
+    Input_Not_Equals_Number(context, context.sym("IsComposite_fact2")[call_count], 1, n).expand(out);
     
     // No overflow
-    clauses.push_back("-<IsComposite_Overflow_" + Z(call_count) + "> 0 ");
+    out.add({-var(context.sym("IsComposite_Overflow")[call_count])});
     
-    return clauses;
 }
 
-// Static member variable for tracking call counts
-int Mul_NBit_1Bit::call_count = 0;
-
 /**
  * Class to represent N-bit multiplication by 1-bit: in_a * in_b == result
  * Implements bitwise AND operation for each bit position
  */
-Mul_NBit_1Bit::Mul_NBit_1Bit(const std::string& in_a, const std::string& in_b, 
-                             const std::string& result, int n) 
-    : in_a(in_a), in_b(in_b), result(result), n(n) {}
+Mul_NBit_1Bit::Mul_NBit_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                             const Sym& result, int n) 
+    : context(context), in_a(in_a), in_b(in_b), result(result), n(n) {}
 
-std::vector<std::string> Mul_NBit_1Bit::expand() const {
-    std::vector<std::string> clauses;
+void Mul_NBit_1Bit::expand(ClauseSink& out) const {
     
     for (int i = 0; i < n; i++) {
         // For each bit position, add clauses that enforce:
         // result[i] = in_a[i] & in_b
-        clauses.push_back(" <" + result + "_" + Z(i) + "> -<" + in_a + "_" + Z(i) + "> -<" + in_b + "> 0 ");
-        clauses.push_back("-<" + result + "_" + Z(i) + "> -<" + in_a + "_" + Z(i) + ">  <" + in_b + "> 0 ");
-        clauses.push_back("-<" + result + "_" + Z(i) + ">  <" + in_a + "_" + Z(i) + "> -<" + in_b + "> 0 ");
-        clauses.push_back("-<" + result + "_" + Z(i) + ">  <" + in_a + "_" + Z(i) + ">  <" + in_b + "> 0 ");
+        const Literal r = var(result[i]);
+        const Literal a = var(in_a[i]);
+        const Literal b = var(in_b);
+        const Literal operands[] = {a, b, r};
+        if (context.options.constant_propagation && fold_gate(context, out, and_gate, operands)) {
+            continue;
+        }
+        out.add({ r, -a, -b});
+        out.add({-r, -a,  b});
+        out.add({-r,  a, -b});
+        out.add({-r,  a,  b});
     }
     
-    return clauses;
 }
 
-// Static member variable for tracking call counts
-int And_1Bit::call_count = 0;
-
 /**
  * Class to represent 1-bit AND operation: in_a & in_b == result
  * Implements logical AND using CNF clauses
  */
-And_1Bit::And_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result)
-    : in_a(in_a), in_b(in_b), result(result) {}
+And_1Bit::And_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), result(result) {}
 
-std::vector<std::string> And_1Bit::expand() const {
-    return {
-        " <" + in_a + ">  <" + in_b + "> -<" + result + "> 0 ",
-        " <" + in_a + "> -<" + in_b + "> -<" + result + "> 0 ",
-        "-<" + in_a + ">  <" + in_b + "> -<" + result + "> 0 ",
-        "-<" + in_a + "> -<" + in_b + ">  <" + result + "> 0 "
-    };
+void And_1Bit::expand(ClauseSink& out) const {
+    emit_gate(context, out, and_gate, GATE_AND, {var(in_a), var(in_b), var(result)});
 }
 
-// Static member variable for tracking call counts
-int LessThan_1Bit::call_count = 0;
-
 /**
  * Class to represent 1-bit less-than comparison: result == (in_a < in_b)
  * Implements comparison logic using CNF clauses
  */
-LessThan_1Bit::LessThan_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result)
-    : in_a(in_a), in_b(in_b), result(result) {}
+LessThan_1Bit::LessThan_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), result(result) {}
 
-std::vector<std::string> LessThan_1Bit::expand() const {
-    return {
-        " <" + in_a + ">  <" + in_b + "> -<" + result + "> 0 ",
-        " <" + in_a + "> -<" + in_b + ">  <" + result + "> 0 ",
-        "-<" + in_a + ">  <" + in_b + "> -<" + result + "> 0 ",
-        "-<" + in_a + "> -<" + in_b + "> -<" + result + "> 0 "
-    };
+void LessThan_1Bit::expand(ClauseSink& out) const {
+    emit_gate(context, out, less_than_gate, GATE_LESS_THAN, {var(in_a), var(in_b), var(result)});
 }
 
-// Static member variable for tracking call counts
-int Equals_1Bit::call_count = 0;
-
 /**
  * Class to represent 1-bit equality comparison: result == (in_a == in_b)
  * Implements equality logic using CNF clauses
  */
-Equals_1Bit::Equals_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result)
-    : in_a(in_a), in_b(in_b), result(result) {}
+Equals_1Bit::Equals_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), result(result) {}
 
-std::vector<std::string> Equals_1Bit::expand() const {
-    return {
-        " <" + in_a + ">  <" + in_b + ">  <" + result + "> 0 ",
-        " <" + in_a + "> -<" + in_b + "> -<" + result + "> 0 ",
-        "-<" + in_a + ">  <" + in_b + "> -<" + result + "> 0 ",
-        "-<" + in_a + "> -<" + in_b + ">  <" + result + "> 0 "
-    };
+void Equals_1Bit::expand(ClauseSink& out) const {
+    emit_gate(context, out, equals_gate, GATE_EQUALS, {var(in_a), var(in_b), var(result)});
 }
 
-// Static member variable for tracking call counts
-int Equals_NBit::call_count = 0;
-
 /**
  * Class to represent N-bit equality comparison: in_a == in_b
  * Implements equality for each bit position
  */
-Equals_NBit::Equals_NBit(const std::string& in_a, const std::string& in_b, int n)
-    : in_a(in_a), in_b(in_b), n(n) {}
+Equals_NBit::Equals_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, int n)
+    : context(context), in_a(in_a), in_b(in_b), n(n) {}
 
-std::vector<std::string> Equals_NBit::expand() const {
-    std::vector<std::string> clauses;
+void Equals_NBit::expand(ClauseSink& out) const {
     for (int i = 0; i < n; i++) {
-        clauses.push_back("-<" + in_a + "_" + Z(i) + ">  <" + in_b + "_" + Z(i) + "> 0 ");
-        clauses.push_back(" <" + in_a + "_" + Z(i) + "> -<" + in_b + "_" + Z(i) + "> 0 ");
+        const Literal a = var(in_a[i]);
+        const Literal b = var(in_b[i]);
+        if (alias_equivalence(context, out, a, b)) {
+            continue;
+        }
+        if (context.options.constant_propagation && fold_equivalence(context, out, a, b)) {
+            continue;
+        }
+        out.add({-a,  b});
+        out.add({ a, -b});
     }
-    return clauses;
 }
 
-// Static member variable for tracking call counts
-int LessThan_NBit::call_count = 0;
-
 /**
  * Class to represent N-bit less-than comparison: in_a < in_b
  * Implements comparison using bit-by-bit analysis with carry logic
  */
-LessThan_NBit::LessThan_NBit(const std::string& in_a, const std::string& in_b, int n)
-    : in_a(in_a), in_b(in_b), n(n) {}
+LessThan_NBit::LessThan_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, int n)
+    : context(context), in_a(in_a), in_b(in_b), n(n) {}
 
-std::vector<std::string> LessThan_NBit::expand() const {
-    std::vector<std::string> clauses;
-    call_count++;
+void LessThan_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<LessThan_NBit>();
+    const Sym equals_bits = context.sym("LessThan_NBit_Equals")[call_count];
+    const Sym less_bits = context.sym("LessThan_NBit_Less")[call_count];
+    const Sym equal_accum = context.sym("LessThan_NBit_EqualAccum")[call_count];
+    const Sym result_bits = context.sym("LessThan_NBit_Result")[call_count];
 
     // Generate Equals_1Bit clauses for each bit position
     for (int i = 0; i < n; i++) {
-        Equals_1Bit equals(in_a + "_" + Z(i), in_b + "_" + Z(i),
-                          "LessThan_NBit_Equals_" + Z(call_count) + "_" + Z(i));
-        auto equals_clauses = equals.expand();
-        clauses.insert(clauses.end(), equals_clauses.begin(), equals_clauses.end());
+        Equals_1Bit equals(context, in_a[i], in_b[i],
+                          equals_bits[i]);
+        equals.expand(out);
     }
 
     // Generate LessThan_1Bit clauses for each bit position
     for (int i = 0; i < n; i++) {
-        LessThan_1Bit less_than(in_a + "_" + Z(i), in_b + "_" + Z(i),
-                               "LessThan_NBit_Less_" + Z(call_count) + "_" + Z(i));
-        auto less_than_clauses = less_than.expand();
-        clauses.insert(clauses.end(), less_than_clauses.begin(), less_than_clauses.end());
+        LessThan_1Bit less_than(context, in_a[i], in_b[i],
+                               less_bits[i]);
+        less_than.expand(out);
     }
 
     // Add initial equal accumulation clause
-    clauses.push_back("<LessThan_NBit_EqualAccum_" + Z(call_count) + "_" + Z(n) + "> 0 ");
+    out.add({var(equal_accum[n])});
 
     // Generate And_1Bit clauses for equal accumulation
     for (int i = 0; i < n; i++) {
-        And_1Bit and_op("LessThan_NBit_EqualAccum_" + Z(call_count) + "_" + Z(i+1),
-                       "LessThan_NBit_Equals_" + Z(call_count) + "_" + Z(i),
-                       "LessThan_NBit_EqualAccum_" + Z(call_count) + "_" + Z(i));
-        auto and_clauses = and_op.expand();
-        clauses.insert(clauses.end(), and_clauses.begin(), and_clauses.end());
+        And_1Bit and_op(context, equal_accum[i+1],
+                       equals_bits[i],
+                       equal_accum[i]);
+        and_op.expand(out);
     }
 
     // Generate And_1Bit clauses for result
     for (int i = 0; i < n; i++) {
-        And_1Bit and_op("LessThan_NBit_EqualAccum_" + Z(call_count) + "_" + Z(i+1),
-                       "LessThan_NBit_Less_" + Z(call_count) + "_" + Z(i),
-                       "LessThan_NBit_Result_" + Z(call_count) + "_" + Z(i));
-        auto and_clauses = and_op.expand();
-        clauses.insert(clauses.end(), and_clauses.begin(), and_clauses.end());
+        And_1Bit and_op(context, equal_accum[i+1],
+                       less_bits[i],
+                       result_bits[i]);
+        and_op.expand(out);
     }
 
     // Add final result clause
-    std::string result_clause;
+    Clause result_clause(n);
     for (int i = 0; i < n; i++) {
-        result_clause += " <LessThan_NBit_Result_" + Z(call_count) + "_" + Z(i) + "> ";
+        result_clause[i] = var(result_bits[i]);
     }
-    result_clause += " 0 ";
-    clauses.push_back(result_clause);
+    out.add(result_clause);
 
-    return clauses;
 }
 
-// Static member variable for tracking call counts
-int DivMod_NBit::call_count = 0;
-
 /**
  * Class to represent division and modulo: in_a == in_b * div + mod
  * Implements division using multiplication and addition constraints
  */
 
 
-DivMod_NBit::DivMod_NBit(const std::string& in_a, const std::string& in_b, 
-                         const std::string& div, const std::string& mod, int n)
-    : in_a(in_a), in_b(in_b), div(div), mod(mod), n(n) {}
+DivMod_NBit::DivMod_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                         const Sym& div, const Sym& mod, int n)
+    : context(context), in_a(in_a), in_b(in_b), div(div), mod(mod), n(n) {}
 
-std::vector<std::string> DivMod_NBit::expand() const {
-    std::vector<std::string> clauses;
-    call_count++;
+void DivMod_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<DivMod_NBit>();
 
     // Multiply in_b and div, store in accumulator
-    Mul_NBit mul_op(in_b, div, 
-                   "DivMod_NBit_Accum_" + Z(call_count),
-                   "DivMode_NBit_MulOverflow_" + Z(call_count),
+    Mul_NBit mul_op(context, in_b, div, 
+                   context.sym("DivMod_NBit_Accum")[call_count],
+                   context.sym("DivMode_NBit_MulOverflow")[call_count],
                    n);
-    auto mul_clauses = mul_op.expand();
-    clauses.insert(clauses.end(), mul_clauses.begin(), mul_clauses.end());
+    mul_op.expand(out);
 
     // Add mod to accumulator, result should equal in_a
-    Add_NBit add_op("DivMod_NBit_Accum_" + Z(call_count),
+    Add_NBit add_op(context, context.sym("DivMod_NBit_Accum")[call_count],
                    mod,
                    in_a,
-                   "DivMode_NBit_AddOverflow_" + Z(call_count),
+                   context.sym("DivMode_NBit_AddOverflow")[call_count],
                    n);
-    auto add_clauses = add_op.expand();
-    clauses.insert(clauses.end(), add_clauses.begin(), add_clauses.end());
+    add_op.expand(out);
 
     // Ensure no overflow in multiplication
-    clauses.push_back("-<DivMode_NBit_MulOverflow_" + Z(call_count) + "> 0 ");
+    out.add({-var(context.sym("DivMode_NBit_MulOverflow")[call_count])});
 
     // Ensure no overflow in addition
-    clauses.push_back("-<DivMode_NBit_AddOverflow_" + Z(call_count) + "> 0 ");
+    out.add({-var(context.sym("DivMode_NBit_AddOverflow")[call_count])});
 
     // Ensure mod is less than in_b
-    LessThan_NBit less_than(mod, in_b, n);
-    auto less_than_clauses = less_than.expand();
-    clauses.insert(clauses.end(), less_than_clauses.begin(), less_than_clauses.end());
+    LessThan_NBit less_than(context, mod, in_b, n);
+    less_than.expand(out);
 
-    return clauses;
 }
 
 
 
-// Static member variable for tracking call counts
-int If_Cond_A_Else_B_1Bit::call_count = 0;
-
 /**
  * Class to represent 1-bit conditional: result == if cond then in_a else in_b
  * Implements multiplexer logic using CNF clauses
  */
-If_Cond_A_Else_B_1Bit::If_Cond_A_Else_B_1Bit(const std::string& in_a, const std::string& in_b, 
-                                             const std::string& cond, const std::string& result)
-    : in_a(in_a), in_b(in_b), cond(cond), result(result) {}
+If_Cond_A_Else_B_1Bit::If_Cond_A_Else_B_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                                             const Sym& cond, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), cond(cond), result(result) {}
 
-std::vector<std::string> If_Cond_A_Else_B_1Bit::expand() const {
-    return {
-        "-<" + cond + "> -<" + in_a + ">  <" + result + "> 0 ",
-        "-<" + cond + ">  <" + in_a + "> -<" + result + "> 0 ",
-        " <" + cond + "> -<" + in_b + ">  <" + result + "> 0 ",
-        " <" + cond + ">  <" + in_b + "> -<" + result + "> 0 "
-    };
+void If_Cond_A_Else_B_1Bit::expand(ClauseSink& out) const {
+    emit_gate(context, out, if_else_gate, GATE_IF_ELSE, {var(cond), var(in_a), var(in_b), var(result)});
 }
 
-// Static member variable for tracking call counts
-int If_Cond_A_Else_B_NBit::call_count = 0;
-
 /**
  * Class to represent N-bit conditional: result == if cond then in_a else in_b
  * Implements conditional selection for each bit position
  */
-If_Cond_A_Else_B_NBit::If_Cond_A_Else_B_NBit(const std::string& in_a, const std::string& in_b, 
-                                             const std::string& cond, const std::string& result, int n)
-    : in_a(in_a), in_b(in_b), cond(cond), result(result), n(n) {}
+If_Cond_A_Else_B_NBit::If_Cond_A_Else_B_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                                             const Sym& cond, const Sym& result, int n)
+    : context(context), in_a(in_a), in_b(in_b), cond(cond), result(result), n(n) {}
 
-std::vector<std::string> If_Cond_A_Else_B_NBit::expand() const {
-    std::vector<std::string> clauses;
+void If_Cond_A_Else_B_NBit::expand(ClauseSink& out) const {
     
     for (int i = 0; i < n; i++) {
-        If_Cond_A_Else_B_1Bit if_op(in_a + "_" + Z(i),
-                                   in_b + "_" + Z(i),
+        If_Cond_A_Else_B_1Bit if_op(context, in_a[i],
+                                   in_b[i],
                                    cond,
-                                   result + "_" + Z(i));
-        auto if_clauses = if_op.expand();
-        clauses.insert(clauses.end(), if_clauses.begin(), if_clauses.end());
+                                   result[i]);
+        if_op.expand(out);
     }
     
-    return clauses;
 }
 
 /**
  * Class to represent 1-bit OR operation: result == in_a | in_b
  * Implements logical OR using CNF clauses
  */
-Or_1Bit::Or_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result)
-    : in_a(in_a), in_b(in_b), result(result) {}
+Or_1Bit::Or_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result)
+    : context(context), in_a(in_a), in_b(in_b), result(result) {}
 
-std::vector<std::string> Or_1Bit::expand() const {
-    return {
-        "-<" + in_a + "> -<" + in_b + ">  <" + result + "> 0 ",
-        "-<" + in_a + ">  <" + in_b + ">  <" + result + "> 0 ",
-        " <" + in_a + "> -<" + in_b + ">  <" + result + "> 0 ",
-        " <" + in_a + ">  <" + in_b + "> -<" + result + "> 0 "
-    };
+void Or_1Bit::expand(ClauseSink& out) const {
+    emit_gate(context, out, or_gate, GATE_OR, {var(in_a), var(in_b), var(result)});
 }
 
 /**
  * Class to represent N-bit to 1-bit OR reduction: result == in_a_1 | in_a_2 | ... | in_a_n
  * Implements OR operation across multiple bits to produce a single result
  */
-Or_NBit_To_1Bit::Or_NBit_To_1Bit(const std::string& in_a, const std::string& result, int n)
-    : in_a(in_a), result(result), n(n) {}
+Or_NBit_To_1Bit::Or_NBit_To_1Bit(GenerationContext& context, const Sym& in_a, const Sym& result, int n)
+    : context(context), in_a(in_a), result(result), n(n) {}
 
-std::vector<std::string> Or_NBit_To_1Bit::expand() const {
-    std::vector<std::string> clauses;
+void Or_NBit_To_1Bit::expand(ClauseSink& out) const {
     
     // First clause: if result is false, all inputs must be false
-    std::string first_clause = "-<" + result + "> ";
+    const Literal r = var(result);
+    Clause first_clause(n + 1);
+    first_clause[0] = -r;
     for (int i = 0; i < n; i++) {
-        first_clause += " <" + in_a + "_" + Z(i) + "> ";
+        first_clause[i + 1] = var(in_a[i]);
     }
-    first_clause += " 0 ";
-    clauses.push_back(first_clause);
+    out.add(first_clause);
     
     // Remaining clauses: if any input is true, result must be true
     for (int i = 0; i < n; i++) {
-        clauses.push_back("<" + result + "> -<" + in_a + "_" + Z(i) + "> 0 ");
+        out.add({r, -var(in_a[i])});
     }
     
-    return clauses;
 }
 
 /**
  * Class to represent power operation: result == in_a ** in_b
  * Implements exponentiation using repeated squaring algorithm
  */
-Pow_NBit::Pow_NBit(const std::string& in_a, const std::string& in_b, const std::string& result, const std::string& over_flow, int n)
-    : in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
+Pow_NBit::Pow_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result, const Sym& over_flow, int n)
+    : context(context), in_a(in_a), in_b(in_b), result(result), over_flow(over_flow), n(n) {}
 
-std::vector<std::string> Pow_NBit::expand() const {
-    static int call_count = 0;
-    call_count++;
+void Pow_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<Pow_NBit>();
     
-    std::vector<std::string> clauses;
     
     // Equals_NBit for temp1[0] and in_a
-    auto equals_clauses = Equals_NBit("Pow_NBit_Temp1_" + Z(call_count) + "_" + Z(0), in_a, n).expand();
-    clauses.insert(clauses.end(), equals_clauses.begin(), equals_clauses.end());
+    Equals_NBit(context, context.sym("Pow_NBit_Temp1")[call_count][0], in_a, n).expand(out);
     
-    // Mul_NBit for temp1[i] * temp1[i] = temp1[i+1] (repeated squaring)
+    // Square_NBit for temp1[i] * temp1[i] = temp1[i+1] (repeated squaring)
     for (int i = 0; i < n; i++) {
-        auto mul_clauses = Mul_NBit("Pow_NBit_Temp1_" + Z(call_count) + "_" + Z(i),
-                                  "Pow_NBit_Temp1_" + Z(call_count) + "_" + Z(i),
-                                  "Pow_NBit_Temp1_" + Z(call_count) + "_" + Z(i+1),
-                                  "Pow_NBit_Temp1Overflow_" + Z(call_count) + "_" + Z(i),
-                                  n).expand();
-        clauses.insert(clauses.end(), mul_clauses.begin(), mul_clauses.end());
+        Square_NBit(context, context.sym("Pow_NBit_Temp1")[call_count][i],
+                                  context.sym("Pow_NBit_Temp1")[call_count][i+1],
+                                  context.sym("Pow_NBit_Temp1Overflow")[call_count][i],
+                                  n).expand(out);
     }
     
     // If_Cond_A_Else_B_NBit for temp2[i] (select power of 2 or 1 based on exponent bit)
     for (int i = 0; i < n; i++) {
-        auto if_clauses = If_Cond_A_Else_B_NBit("Pow_NBit_Temp1_" + Z(call_count) + "_" + Z(i),
-                                               "One_NBit_" + Z(n),
-                                               in_b + "_" + Z(i),
-                                               "Pow_NBit_Temp2_" + Z(call_count) + "_" + Z(i),
-                                               n).expand();
-        clauses.insert(clauses.end(), if_clauses.begin(), if_clauses.end());
+        If_Cond_A_Else_B_NBit(context, context.sym("Pow_NBit_Temp1")[call_count][i],
+                                               context.sym("One_NBit")[n],
+                                               in_b[i],
+                                               context.sym("Pow_NBit_Temp2")[call_count][i],
+                                               n).expand(out);
     }
     
     // Input_Equals_Number for pow_accum[0] = 1
-    auto input_clauses = Input_Equals_Number("Pow_NBit_PowAccum_" + Z(call_count) + "_" + Z(0), 1, n).expand();
-    clauses.insert(clauses.end(), input_clauses.begin(), input_clauses.end());
+    Input_Equals_Number(context, context.sym("Pow_NBit_PowAccum")[call_count][0], 1, n).expand(out);
     
     // Mul_NBit for pow_accum[i+1] (accumulate the result)
     for (int i = 0; i < n; i++) {
-        auto mul_clauses = Mul_NBit("Pow_NBit_Temp2_" + Z(call_count) + "_" + Z(i),
-                                  "Pow_NBit_PowAccum_" + Z(call_count) + "_" + Z(i),
-                                  "Pow_NBit_PowAccum_" + Z(call_count) + "_" + Z(i+1),
-                                  "Pow_NBit_PowAccumOverflow_" + Z(call_count) + "_" + Z(i),
-                                  n).expand();
-        clauses.insert(clauses.end(), mul_clauses.begin(), mul_clauses.end());
+        Mul_NBit(context, context.sym("Pow_NBit_Temp2")[call_count][i],
+                                  context.sym("Pow_NBit_PowAccum")[call_count][i],
+                                  context.sym("Pow_NBit_PowAccum")[call_count][i+1],
+                                  context.sym("Pow_NBit_PowAccumOverflow")[call_count][i],
+                                  n).expand(out);
     }
     
     // Equals_NBit for result and pow_accum[n]
-    auto result_clauses = Equals_NBit(result,
-                                    "Pow_NBit_PowAccum_" + Z(call_count) + "_" + Z(n),
-                                    n).expand();
-    clauses.insert(clauses.end(), result_clauses.begin(), result_clauses.end());
+    Equals_NBit(context, result,
+                                    context.sym("Pow_NBit_PowAccum")[call_count][n],
+                                    n).expand(out);
     
     // Initialize overflow accum
-    clauses.push_back("-<Pow_NBit_PowAccumOverflowAccum_" + Z(call_count) + "_" + Z(0) + "> 0 ");
+    out.add({-var(context.sym("Pow_NBit_PowAccumOverflowAccum")[call_count][0])});
     
     // Or_1Bit for overflow accum (track overflow across iterations)
     for (int i = 0; i < n; i++) {
-        auto or_clauses = Or_1Bit("Pow_NBit_PowAccumOverflowAccum_" + Z(call_count) + "_" + Z(i),
-                                 "Pow_NBit_Temp1Overflow_" + Z(call_count) + "_" + Z(i),
-                                 "Pow_NBit_PowAccumOverflowAccum_" + Z(call_count) + "_" + Z(i+1)).expand();
-        clauses.insert(clauses.end(), or_clauses.begin(), or_clauses.end());
+        Or_1Bit(context, context.sym("Pow_NBit_PowAccumOverflowAccum")[call_count][i],
+                                 context.sym("Pow_NBit_Temp1Overflow")[call_count][i],
+                                 context.sym("Pow_NBit_PowAccumOverflowAccum")[call_count][i+1]).expand(out);
     }
     
     // If_Cond_A_Else_B_1Bit for overflow temp (conditional overflow handling)
     for (int i = 0; i < n; i++) {
-        auto if_clauses = If_Cond_A_Else_B_1Bit("Pow_NBit_PowAccumOverflowAccum_" + Z(call_count) + "_" + Z(i+1),
-                                               "Zero_1Bit_" + Z(1),
-                                               in_b + "_" + Z(i+1),
-                                               "Pow_NBit_OverflowTemp_" + Z(call_count) + "_" + Z(i)).expand();
-        clauses.insert(clauses.end(), if_clauses.begin(), if_clauses.end());
+        If_Cond_A_Else_B_1Bit(context, context.sym("Pow_NBit_PowAccumOverflowAccum")[call_count][i+1],
+                                               context.sym("Zero_1Bit")[1],
+                                               in_b[i+1],
+                                               context.sym("Pow_NBit_OverflowTemp")[call_count][i]).expand(out);
     }
     
     // Or_NBit_To_1Bit for pow accum overflow
-    auto or_clauses = Or_NBit_To_1Bit("Pow_NBit_PowAccumOverflow_" + Z(call_count),
-                                     "Pow_NBit_PowAccumOverflow_OR_" + Z(call_count),
-                                     n).expand();
-    clauses.insert(clauses.end(), or_clauses.begin(), or_clauses.end());
+    Or_NBit_To_1Bit(context, context.sym("Pow_NBit_PowAccumOverflow")[call_count],
+                                     context.sym("Pow_NBit_PowAccumOverflow_OR")[call_count],
+                                     n).expand(out);
     
     // Or_NBit_To_1Bit for overflow temp
-    auto or_temp_clauses = Or_NBit_To_1Bit("Pow_NBit_OverflowTemp_" + Z(call_count),
-                                          "Pow_NBit_OverflowTemp_OR_" + Z(call_count),
-                                          n).expand();
-    clauses.insert(clauses.end(), or_temp_clauses.begin(), or_temp_clauses.end());
+    Or_NBit_To_1Bit(context, context.sym("Pow_NBit_OverflowTemp")[call_count],
+                                          context.sym("Pow_NBit_OverflowTemp_OR")[call_count],
+                                          n).expand(out);
     
     // Or_1Bit for final overflow
-    auto final_or_clauses = Or_1Bit("Pow_NBit_PowAccumOverflow_OR_" + Z(call_count),
-                                  "Pow_NBit_OverflowTemp_OR_" + Z(call_count),
-                                  over_flow).expand();
-    clauses.insert(clauses.end(), final_or_clauses.begin(), final_or_clauses.end());
+    Or_1Bit(context, context.sym("Pow_NBit_PowAccumOverflow_OR")[call_count],
+                                  context.sym("Pow_NBit_OverflowTemp_OR")[call_count],
+                                  over_flow).expand(out);
     
-    return clauses;
 }
 
 /**
  * Class to represent double-size assignment: result[0...n] == in_a, result[n...(2*n)] == 0
  * Implements zero-extension of an N-bit value to 2N bits
  */
-DoubleSize_Assign::DoubleSize_Assign(const std::string& in_a, const std::string& result, int n)
-    : in_a(in_a), result(result), n(n) {}
+DoubleSize_Assign::DoubleSize_Assign(GenerationContext& context, const Sym& in_a, const Sym& result, int n)
+    : context(context), in_a(in_a), result(result), n(n) {}
 
-std::vector<std::string> DoubleSize_Assign::expand() const {
-    std::vector<std::string> clauses;
+void DoubleSize_Assign::expand(ClauseSink& out) const {
     
     // Equals_NBit for result[0...n] == in_a
-    auto equals_clauses = Equals_NBit(in_a, result, n).expand();
-    clauses.insert(clauses.end(), equals_clauses.begin(), equals_clauses.end());
+    Equals_NBit(context, in_a, result, n).expand(out);
     
     // Set result[n...(2*n)] to 0
     for (int i = n; i < (n * 2); i++) {
-        clauses.push_back("-<" + result + "_" + Z(i) + "> 0 ");
+        out.add({-var(result[i])});
     }
     
-    return clauses;
 }
 
 /**
  * Class to represent modular exponentiation: result == (base ** exp) % mod
  * Implements fast modular exponentiation using repeated squaring
  */
-PowMod_NBit::PowMod_NBit(const std::string& base, const std::string& exp, const std::string& mod, const std::string& result, int n)
-    : base(base), exp(exp), mod(mod), result(result), n(n) {}
+PowMod_NBit::PowMod_NBit(GenerationContext& context, const Sym& base, const Sym& exp, const Sym& mod, const Sym& result, int n)
+    : context(context), base(base), exp(exp), mod(mod), result(result), n(n) {}
 
-std::vector<std::string> PowMod_NBit::expand() const {
-    static int call_count = 0;
-    call_count++;
+void PowMod_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<PowMod_NBit>();
+    if (context.options.modmul == ModularMultiplication::Interleaved) {
+        expand_interleaved(out, call_count);
+        return;
+    }
     
-    std::vector<std::string> clauses;
     
     // DoubleSize_Assign for base, exp, and mod (extend to 2N bits for intermediate calculations)
-    auto base_double_clauses = DoubleSize_Assign(base, "PowMod_NBit_Base_DoubleSize_" + Z(call_count), n).expand();
-    clauses.insert(clauses.end(), base_double_clauses.begin(), base_double_clauses.end());
+    DoubleSize_Assign(context, base, context.sym("PowMod_NBit_Base_DoubleSize")[call_count], n).expand(out);
     
-    auto exp_double_clauses = DoubleSize_Assign(exp, "PowMod_NBit_Exp_DoubleSize_" + Z(call_count), n).expand();
-    clauses.insert(clauses.end(), exp_double_clauses.begin(), exp_double_clauses.end());
+    DoubleSize_Assign(context, exp, context.sym("PowMod_NBit_Exp_DoubleSize")[call_count], n).expand(out);
     
-    auto mod_double_clauses = DoubleSize_Assign(mod, "PowMod_NBit_Mod_DoubleSize_" + Z(call_count), n).expand();
-    clauses.insert(clauses.end(), mod_double_clauses.begin(), mod_double_clauses.end());
+    DoubleSize_Assign(context, mod, context.sym("PowMod_NBit_Mod_DoubleSize")[call_count], n).expand(out);
     
     // Initialize partial_result_0 = 1
-    auto init_clauses = Input_Equals_Number("PowMod_NBit_PartialResult_" + Z(call_count) + "_" + Z(0), 1, n*2).expand();
-    clauses.insert(clauses.end(), init_clauses.begin(), init_clauses.end());
+    Input_Equals_Number(context, context.sym("PowMod_NBit_PartialResult")[call_count][0], 1, n*2).expand(out);
     
     // Initialize current_pow_0 = base
-    auto current_pow_clauses = Equals_NBit("PowMod_NBit_CurrentPow_" + Z(call_count) + "_" + Z(0),
-                                         "PowMod_NBit_Base_DoubleSize_" + Z(call_count),
-                                         n*2).expand();
-    clauses.insert(clauses.end(), current_pow_clauses.begin(), current_pow_clauses.end());
+    Equals_NBit(context, context.sym("PowMod_NBit_CurrentPow")[call_count][0],
+                                         context.sym("PowMod_NBit_Base_DoubleSize")[call_count],
+                                         n*2).expand(out);
     
     // For each bit in exp
     for (int i = 0; i < n; i++) {
         // bit_factor_i = if exp_i current_pow else 1
-        auto bit_factor_clauses = If_Cond_A_Else_B_NBit("PowMod_NBit_CurrentPow_" + Z(call_count) + "_" + Z(i),
-                                                       "One_NBit_" + Z(n*2),
-                                                       "PowMod_NBit_Exp_DoubleSize_" + Z(call_count) + "_" + Z(i),
-                                                       "PowMod_NBit_BitFactor_" + Z(call_count) + "_" + Z(i),
-                                                       n*2).expand();
-        clauses.insert(clauses.end(), bit_factor_clauses.begin(), bit_factor_clauses.end());
+        If_Cond_A_Else_B_NBit(context, context.sym("PowMod_NBit_CurrentPow")[call_count][i],
+                                                       context.sym("One_NBit")[n*2],
+                                                       context.sym("PowMod_NBit_Exp_DoubleSize")[call_count][i],
+                                                       context.sym("PowMod_NBit_BitFactor")[call_count][i],
+                                                       n*2).expand(out);
         
         // multipled_i = partial_result * bit_factor_i
-        auto multipled_clauses = Mul_NBit("PowMod_NBit_PartialResult_" + Z(call_count) + "_" + Z(i),
-                                        "PowMod_NBit_BitFactor_" + Z(call_count) + "_" + Z(i),
-                                        "PowMod_NBit_Multipled_" + Z(call_count) + "_" + Z(i),
-                                        "PowMod_NBit_MultipledOverflow_" + Z(call_count) + "_" + Z(i),
-                                        n*2).expand();
-        clauses.insert(clauses.end(), multipled_clauses.begin(), multipled_clauses.end());
+        Mul_NBit(context, context.sym("PowMod_NBit_PartialResult")[call_count][i],
+                                        context.sym("PowMod_NBit_BitFactor")[call_count][i],
+                                        context.sym("PowMod_NBit_Multipled")[call_count][i],
+                                        context.sym("PowMod_NBit_MultipledOverflow")[call_count][i],
+                                        n*2).expand(out);
         
         // partial_result_(i+1) = multipled_i % mod
-        auto divmod_clauses = DivMod_NBit("PowMod_NBit_Multipled_" + Z(call_count) + "_" + Z(i),
-                                        "PowMod_NBit_Mod_DoubleSize_" + Z(call_count),
-                                        "PowMod_NBit_Div1_" + Z(call_count) + "_" + Z(i),
-                                        "PowMod_NBit_PartialResult_" + Z(call_count) + "_" + Z(i+1),
-                                        n*2).expand();
-        clauses.insert(clauses.end(), divmod_clauses.begin(), divmod_clauses.end());
+        DivMod_NBit(context, context.sym("PowMod_NBit_Multipled")[call_count][i],
+                                        context.sym("PowMod_NBit_Mod_DoubleSize")[call_count],
+                                        context.sym("PowMod_NBit_Div1")[call_count][i],
+                                        context.sym("PowMod_NBit_PartialResult")[call_count][i+1],
+                                        n*2).expand(out);
         
         // square_base_i = current_pow_i * current_pow_i
-        auto square_clauses = Mul_NBit("PowMod_NBit_CurrentPow_" + Z(call_count) + "_" + Z(i),
-                                     "PowMod_NBit_CurrentPow_" + Z(call_count) + "_" + Z(i),
-                                     "PowMod_NBit_SquareBase_" + Z(call_count) + "_" + Z(i),
-                                     "PowMod_NBit_SquareBaseOverflow_" + Z(call_count) + "_" + Z(i),
-                                     n*2).expand();
-        clauses.insert(clauses.end(), square_clauses.begin(), square_clauses.end());
+        Square_NBit(context, context.sym("PowMod_NBit_CurrentPow")[call_count][i],
+                                     context.sym("PowMod_NBit_SquareBase")[call_count][i],
+                                     context.sym("PowMod_NBit_SquareBaseOverflow")[call_count][i],
+                                     n*2).expand(out);
         
         // current_pow_(i+1) = square_base_i % mod
-        auto current_pow_next_clauses = DivMod_NBit("PowMod_NBit_SquareBase_" + Z(call_count) + "_" + Z(i),
-                                                  "PowMod_NBit_Mod_DoubleSize_" + Z(call_count),
-                                                  "PowMod_NBit_Div2_" + Z(call_count) + "_" + Z(i),
-                                                  "PowMod_NBit_CurrentPow_" + Z(call_count) + "_" + Z(i+1),
-                                                  n*2).expand();
-        clauses.insert(clauses.end(), current_pow_next_clauses.begin(), current_pow_next_clauses.end());
+        DivMod_NBit(context, context.sym("PowMod_NBit_SquareBase")[call_count][i],
+                                                  context.sym("PowMod_NBit_Mod_DoubleSize")[call_count],
+                                                  context.sym("PowMod_NBit_Div2")[call_count][i],
+                                                  context.sym("PowMod_NBit_CurrentPow")[call_count][i+1],
+                                                  n*2).expand(out);
     }
     
     // result = partial_result_n
-    auto result_clauses = Equals_NBit(result,
-                                    "PowMod_NBit_PartialResult_" + Z(call_count) + "_" + Z(n),
-                                    n).expand();
-    clauses.insert(clauses.end(), result_clauses.begin(), result_clauses.end());
+    Equals_NBit(context, result,
+                                    context.sym("PowMod_NBit_PartialResult")[call_count][n],
+                                    n).expand(out);
+    
+}
+
+/**
+ * The same exponentiation with ModMul_NBit at N bits: current_pow_0 = base % mod (a DivMod_NBit,
+ * which also rejects mod == 0 as the 2N-bit path does) and partial_result_0 = 1 % mod, so every
+ * multiplicand stays below mod
+ */
+void PowMod_NBit::expand_interleaved(ClauseSink& out, int call_count) const {
+    const Sym one = context.sym("PowMod_NBit_One")[call_count];
+    
+    // current_pow_0 = base % mod
+    DivMod_NBit(context, base, mod, context.sym("PowMod_NBit_Div0")[call_count],
+                context.sym("PowMod_NBit_CurrentPow")[call_count][0], n).expand(out);
+    
+    // one = 1 % mod: 0 when mod == 1, else 1
+    Clause not_one{-var(one[0]), -var(mod[0])};
+    out.add({var(one[0]), var(mod[0])});
+    for (int i = 1; i < n; ++i) {
+        not_one.push_back(var(mod[i]));
+        out.add({var(one[0]), -var(mod[i])});
+        out.add({-var(one[i])});
+    }
+    out.add(not_one);
+    
+    // partial_result_0 = one
+    Equals_NBit(context, context.sym("PowMod_NBit_PartialResult")[call_count][0], one, n).expand(out);
+    
+    for (int i = 0; i < n; i++) {
+        // bit_factor_i = if exp_i current_pow_i else one
+        If_Cond_A_Else_B_NBit(context, context.sym("PowMod_NBit_CurrentPow")[call_count][i], one, exp[i],
+                              context.sym("PowMod_NBit_BitFactor")[call_count][i], n).expand(out);
+        
+        // partial_result_(i+1) = (bit_factor_i * partial_result_i) % mod
+        ModMul_NBit(context, context.sym("PowMod_NBit_BitFactor")[call_count][i],
+                    context.sym("PowMod_NBit_PartialResult")[call_count][i], mod,
+                    context.sym("PowMod_NBit_PartialResult")[call_count][i+1], n).expand(out);
+        
+        // current_pow_(i+1) = (current_pow_i * current_pow_i) % mod
+        ModMul_NBit(context, context.sym("PowMod_NBit_CurrentPow")[call_count][i],
+                    context.sym("PowMod_NBit_CurrentPow")[call_count][i], mod,
+                    context.sym("PowMod_NBit_CurrentPow")[call_count][i+1], n).expand(out);
+    }
     
-    return clauses;
+    // result = partial_result_n
+    Equals_NBit(context, result, context.sym("PowMod_NBit_PartialResult")[call_count][n], n).expand(out);
 }
 
 /**
  * Class to add a literal to each clause in a condition
  * Used for implementing logical operations on CNF conditions
  */
-AddLiteralToCondition::AddLiteralToCondition(const std::string& literal, const std::vector<std::string>& condition)
-    : literal(literal), condition(condition) {}
+AddLiteralToCondition::AddLiteralToCondition(GenerationContext& context, Literal literal, ClauseEmitter condition)
+    : context(context), literal(literal), condition(std::move(condition)) {}
 
-std::vector<std::string> AddLiteralToCondition::expand() const {
-    std::vector<std::string> clauses;
+void AddLiteralToCondition::expand(ClauseSink& out) const {
     
-    // Add the literal to each clause in the condition
-    for (const auto& clause : condition) {
-        clauses.push_back(literal + " " + clause);
-    }
+    // Add the literal to each clause in the condition as it is emitted
+    PrefixLiteralSink extended(literal, out);
+    condition(extended);
     
-    return clauses;
 }
 
 /**
  * Class to represent logical OR between two conditions: condition1 || condition2
  * Implements disjunction using Tseitin transformation
+ * The selector variable is numbered when the object is constructed, so nested
+ * conditions keep the numbering of the order in which they were built
+ * With options.structural_hashing, an Or whose two conditions add the same clauses as an
+ * earlier Or (compared by digest) merges its selector into that Or's (GenerationContext::alias).
+ * The selector occurs only in those clauses, so whichever value suits one of the Ors, the
+ * first condition holding or not, suits every other Or with the same conditions
  */
-Or_Condition::Or_Condition(const std::vector<std::string>& condition1,
-                          const std::vector<std::string>& condition2)
-    : condition1(condition1), condition2(condition2) {}
+Or_Condition::Or_Condition(GenerationContext& context, ClauseEmitter condition1,
+                          ClauseEmitter condition2)
+    : context(context), condition1(std::move(condition1)), condition2(std::move(condition2)), instance(context.next_instance<Or_Condition>()) {}
 
-std::vector<std::string> Or_Condition::expand() const {
-    std::vector<std::string> clauses;
-    static int call_count = 0;
-    std::string or_literal = "<Or_Condition_" + Z(++call_count)+">";
-    
-    // Get expanded conditions from both function objects
-    auto expanded_condition1 = condition1;
-    auto expanded_condition2 = condition2;
+void Or_Condition::expand(ClauseSink& out) const {
+    Literal or_literal = var(context.sym("Or_Condition")[instance]);
     
-    // Add literal to condition1 (positive)
-    AddLiteralToCondition add_literal1(or_literal, expanded_condition1);
-    auto new_clauses1 = add_literal1.expand();
-    clauses.insert(clauses.end(), new_clauses1.begin(), new_clauses1.end());
-    
-    // Add negated literal to condition2
-    std::string negated_literal = "-" + or_literal;
-    AddLiteralToCondition add_literal2(negated_literal, expanded_condition2);
-    auto new_clauses2 = add_literal2.expand();
-    clauses.insert(clauses.end(), new_clauses2.begin(), new_clauses2.end());
+    if (!context.options.structural_hashing) {
+        // Add literal to condition1 (positive)
+        AddLiteralToCondition add_literal1(context, or_literal, condition1);
+        add_literal1.expand(out);
+        
+        // Add negated literal to condition2
+        Literal negated_literal = -or_literal;
+        AddLiteralToCondition add_literal2(context, negated_literal, condition2);
+        add_literal2.expand(out);
+        return;
+    }
     
-    return clauses;
+    // Same, with the clauses of each condition digested on their way to the prefix
+    unsigned long long digests[2] = {};
+    AddLiteralToCondition(context, or_literal, [&](ClauseSink& sink) {
+        DigestSink digest(context, sink);
+        condition1(digest);
+        digests[0] = digest.digest();
+    }).expand(out);
+    AddLiteralToCondition(context, -or_literal, [&](ClauseSink& sink) {
+        DigestSink digest(context, sink);
+        condition2(digest);
+        digests[1] = digest.digest();
+    }).expand(out);
+    GenerationContext::GateKey key = {OR_CONDITION};
+    for (unsigned long long digest : digests) {
+        key.push_back(static_cast<int>(digest >> 32));
+        key.push_back(static_cast<int>(digest & 0xffffffffULL));
+    }
+    const Literal existing = context.find_gate(key);
+    if (existing == 0) {
+        context.record_gate(key, or_literal);
+    } else {
+        context.alias(existing, or_literal);
+    }
 }
 
 /**
  * Class to represent logical AND between two conditions: condition1 && condition2
  * Implements conjunction by combining all clauses from both conditions
  */
-And_Condition::And_Condition(const std::vector<std::string>& condition1,
-                           const std::vector<std::string>& condition2)
-    : condition1(condition1), condition2(condition2) {}
+And_Condition::And_Condition(GenerationContext& context, ClauseEmitter condition1,
+                           ClauseEmitter condition2)
+    : context(context), condition1(std::move(condition1)), condition2(std::move(condition2)) {}
 
-std::vector<std::string> And_Condition::expand() const {
-    std::vector<std::string> clauses;
+void And_Condition::expand(ClauseSink& out) const {
     
     // Add all clauses from condition1
-    clauses.insert(clauses.end(), condition1.begin(), condition1.end());
+    condition1(out);
     
     // Add all clauses from condition2
-    clauses.insert(clauses.end(), condition2.begin(), condition2.end());
+    condition2(out);
     
-    return clauses;
 }
 
 /**
  * Class to represent sum of multiple N-bit values: output == input_1 + input_2 + ... + input_(data_count)
  * Implements accumulation using repeated addition
  */
-Sum_NBit::Sum_NBit(const std::string& input, const std::string& output,
-                   const std::string& overflow, int data_count, int bits)
-    : input(input), output(output), overflow(overflow), data_count(data_count), bits(bits) {}
+Sum_NBit::Sum_NBit(GenerationContext& context, const Sym& input, const Sym& output,
+                   const Sym& overflow, int data_count, int bits)
+    : context(context), input(input), output(output), overflow(overflow), data_count(data_count), bits(bits) {}
 
-std::vector<std::string> Sum_NBit::expand() const {
-    static int call_count = 0;
-    call_count++;
+void Sum_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<Sum_NBit>();
     
-    std::vector<std::string> clauses;
     
     // Initialize accumulator to 0
-    Input_Equals_Number init_op("Sum_NBit_Accum_" + Z(call_count) + "_" + Z(0), 0, bits);
-    auto init_clauses = init_op.expand();
-    clauses.insert(clauses.end(), init_clauses.begin(), init_clauses.end());
+    Input_Equals_Number init_op(context, context.sym("Sum_NBit_Accum")[call_count][0], 0, bits);
+    init_op.expand(out);
     
     // Add each input to the accumulator
     for (int i = 0; i < data_count; i++) {
         Add_NBit add_op(
-            input + "_" + Z(i),
-            "Sum_NBit_Accum_" + Z(call_count) + "_" + Z(i),
-            "Sum_NBit_Accum_" + Z(call_count) + "_" + Z(i + 1),
-            "Sum_NBit_Overflow_" + Z(call_count) + "_" + Z(i),
+            context,
+            input[i],
+            context.sym("Sum_NBit_Accum")[call_count][i],
+            context.sym("Sum_NBit_Accum")[call_count][i + 1],
+            context.sym("Sum_NBit_Overflow")[call_count][i],
             bits
         );
-        auto add_clauses = add_op.expand();
-        clauses.insert(clauses.end(), add_clauses.begin(), add_clauses.end());
+        add_op.expand(out);
     }
     
     // Set output equal to final accumulator value
     Equals_NBit equals_op(
+        context,
         output,
-        "Sum_NBit_Accum_" + Z(call_count) + "_" + Z(data_count),
+        context.sym("Sum_NBit_Accum")[call_count][data_count],
         bits
     );
-    auto equals_clauses = equals_op.expand();
-    clauses.insert(clauses.end(), equals_clauses.begin(), equals_clauses.end());
+    equals_op.expand(out);
     
     // Combine all overflow bits into a single overflow output
     Or_NBit_To_1Bit or_op(
-        "Sum_NBit_Overflow_" + Z(call_count),
+        context,
+        context.sym("Sum_NBit_Overflow")[call_count],
         overflow,
         data_count
     );
-    auto or_clauses = or_op.expand();
-    clauses.insert(clauses.end(), or_clauses.begin(), or_clauses.end());
+    or_op.expand(out);
     
-    return clauses;
 }
 
 // Static member variable definition for Product_NBit
-int Product_NBit::call_count = 0;
 
 /**
  * Class to represent product of multiple N-bit values: output == input_1 * input_2 * ... * input_(data_count)
  * Implements accumulation using repeated multiplication
  */
-Product_NBit::Product_NBit(const std::string& input, const std::string& output,
-                          const std::string& overflow, int data_count, int bits)
-    : input(input), output(output), overflow(overflow), data_count(data_count), bits(bits) {}
+Product_NBit::Product_NBit(GenerationContext& context, const Sym& input, const Sym& output,
+                          const Sym& overflow, int data_count, int bits)
+    : context(context), input(input), output(output), overflow(overflow), data_count(data_count), bits(bits) {}
 
-std::vector<std::string> Product_NBit::expand() const {
-//    static int call_count = 0;
-    call_count++;
+void Product_NBit::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<Product_NBit>();
     
-    std::vector<std::string> clauses;
     
     // Initialize accumulator to 1
-    Input_Equals_Number init_op("Product_NBit_Accum_" + Z(call_count) + "_" + Z(0), 1, bits);
-    auto init_clauses = init_op.expand();
-    clauses.insert(clauses.end(), init_clauses.begin(), init_clauses.end());
+    Input_Equals_Number init_op(context, context.sym("Product_NBit_Accum")[call_count][0], 1, bits);
+    init_op.expand(out);
     
     // Multiply each input with the accumulator
     for (int i = 0; i < data_count; i++) {
         Mul_NBit mul_op(
-            input + "_" + Z(i),
-            "Product_NBit_Accum_" + Z(call_count) + "_" + Z(i),
-            "Product_NBit_Accum_" + Z(call_count) + "_" + Z(i + 1),
-            "Product_NBit_Overflow_" + Z(call_count) + "_" + Z(i),
+            context,
+            input[i],
+            context.sym("Product_NBit_Accum")[call_count][i],
+            context.sym("Product_NBit_Accum")[call_count][i + 1],
+            context.sym("Product_NBit_Overflow")[call_count][i],
             bits
         );
-        auto mul_clauses = mul_op.expand();
-        clauses.insert(clauses.end(), mul_clauses.begin(), mul_clauses.end());
+        mul_op.expand(out);
     }
     
     // Set output equal to final accumulator value
     Equals_NBit equals_op(
+        context,
         output,
-        "Product_NBit_Accum_" + Z(call_count) + "_" + Z(data_count),
+        context.sym("Product_NBit_Accum")[call_count][data_count],
         bits
     );
-    auto equals_clauses = equals_op.expand();
-    clauses.insert(clauses.end(), equals_clauses.begin(), equals_clauses.end());
+    equals_op.expand(out);
     
     // Combine all overflow bits into a single overflow output
     Or_NBit_To_1Bit or_op(
-        "Product_NBit_Overflow_" + Z(call_count),
+        context,
+        context.sym("Product_NBit_Overflow")[call_count],
         overflow,
         data_count
     );
-    auto or_clauses = or_op.expand();
-    clauses.insert(clauses.end(), or_clauses.begin(), or_clauses.end());
+    or_op.expand(out);
     
-    return clauses;
 }
 
 // Static member variable definition for FermatTest
-int FermatTest::call_count = 0;
 
 /**
  * Class to represent Fermat primality test: (generator ** pow) % mod == 1
  * Implements the basic Fermat test for a given generator, power, and modulus
  */
-FermatTest::FermatTest(const std::string& generator, const std::string& pow, 
-                       const std::string& mod, int n)
-    : generator(generator), pow(pow), mod(mod), n(n) {}
+FermatTest::FermatTest(GenerationContext& context, const Sym& generator, const Sym& pow, 
+                       const Sym& mod, int n)
+    : context(context), generator(generator), pow(pow), mod(mod), n(n) {}
 
-std::vector<std::string> FermatTest::expand() const {
-//    static int call_count = 0;
-    call_count++;
+void FermatTest::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<FermatTest>();
     
-    std::vector<std::string> clauses;
     
     // Input_Not_Equals_Number for generator != 0
-    auto gen_not_zero_clause = Input_Not_Equals_Number(generator, 0, n).expand();
-    clauses.push_back(gen_not_zero_clause);
+    Input_Not_Equals_Number(context, generator, 0, n).expand(out);
     
     // Input_Not_Equals_Number for generator != 1
-    auto gen_not_one_clause = Input_Not_Equals_Number(generator, 1, n).expand();
-    clauses.push_back(gen_not_one_clause);
+    Input_Not_Equals_Number(context, generator, 1, n).expand(out);
     
     // PowMod_NBit for (generator ** pow) % mod
-    PowMod_NBit powmod_op(generator, pow, mod, "FermatTest_" + Z(call_count), n);
-    auto powmod_clauses = powmod_op.expand();
-    clauses.insert(clauses.end(), powmod_clauses.begin(), powmod_clauses.end());
+    PowMod_NBit powmod_op(context, generator, pow, mod, context.sym("FermatTest")[call_count], n);
+    powmod_op.expand(out);
     
     // Input_Equals_Number for result == 1
-    auto result_equals_one_clauses = Input_Equals_Number("FermatTest_" + Z(call_count), 1, n).expand();
-    clauses.insert(clauses.end(), result_equals_one_clauses.begin(), result_equals_one_clauses.end());
+    Input_Equals_Number(context, context.sym("FermatTest")[call_count], 1, n).expand(out);
     
-    return clauses;
 }
 
 // Static member variable definition for FermatTest2
-int FermatTest2::call_count = 0;
 
 /**
  * Class to represent Fermat primality test for prime: (generator ** (prime-1)) % prime == 1
  * Implements the standard Fermat test used in primality testing
  */
-FermatTest2::FermatTest2(const std::string& generator, const std::string& prime, int n)
-    : generator(generator), prime(prime), n(n) {}
+FermatTest2::FermatTest2(GenerationContext& context, const Sym& generator, const Sym& prime, int n)
+    : context(context), generator(generator), prime(prime), n(n) {}
 
-std::vector<std::string> FermatTest2::expand() const {
-//    static int call_count = 0;
-    call_count++;
+void FermatTest2::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<FermatTest2>();
     
-    std::vector<std::string> clauses;
     
-    // Add_NBit for prime - 1
-    Add_NBit add_op("FermatTest2_Prime_Minus1_" + Z(call_count),
-                    "One_NBit_" + Z(n),
-                    prime,
-                    "FermatTest2_Prime_Minus1_Overflow_" + Z(call_count),
+    // Dec_NBit for prime - 1
+    Dec_NBit dec_op(context, prime,
+                    context.sym("FermatTest2_Prime_Minus1")[call_count],
+                    context.sym("FermatTest2_Prime_Minus1_Overflow")[call_count],
                     n);
-    auto add_clauses = add_op.expand();
-    clauses.insert(clauses.end(), add_clauses.begin(), add_clauses.end());
+    dec_op.expand(out);
     
     // Ensure no overflow in the subtraction
-    clauses.push_back("-<FermatTest2_Prime_Minus1_Overflow_" + Z(call_count) + "> 0 ");
+    out.add({-var(context.sym("FermatTest2_Prime_Minus1_Overflow")[call_count])});
     
     // FermatTest for (generator ** (prime-1)) % prime == 1
-    FermatTest fermat_op(generator,
-                        "FermatTest2_Prime_Minus1_" + Z(call_count),
+    FermatTest fermat_op(context, generator,
+                        context.sym("FermatTest2_Prime_Minus1")[call_count],
                         prime,
                         n);
-    auto fermat_clauses = fermat_op.expand();
-    clauses.insert(clauses.end(), fermat_clauses.begin(), fermat_clauses.end());
+    fermat_op.expand(out);
     
-    return clauses;
 }
 
 // Static member variable definition for FermatTest3
-int FermatTest3::call_count = 0;
 
 /**
  * Class to represent inverse Fermat test: (generator ** pow) % mod != 1
  * Implements the negation of Fermat test, used for composite number detection
  */
-FermatTest3::FermatTest3(const std::string& generator, const std::string& pow, 
-                         const std::string& mod, int n)
-    : generator(generator), pow(pow), mod(mod), n(n) {}
+FermatTest3::FermatTest3(GenerationContext& context, const Sym& generator, const Sym& pow, 
+                         const Sym& mod, int n)
+    : context(context), generator(generator), pow(pow), mod(mod), n(n) {}
 
-std::vector<std::string> FermatTest3::expand() const {
-//    static int call_count = 0;
-    call_count++;
+void FermatTest3::expand(ClauseSink& out) const {
+    const int call_count = context.next_instance<FermatTest3>();
     
-    std::vector<std::string> clauses;
     
     // Input_Not_Equals_Number for generator != 0
-    auto gen_not_zero_clause = Input_Not_Equals_Number(generator, 0, n).expand();
-    clauses.push_back(gen_not_zero_clause);
+    Input_Not_Equals_Number(context, generator, 0, n).expand(out);
     
     // Input_Not_Equals_Number for generator != 1
-    auto gen_not_one_clause = Input_Not_Equals_Number(generator, 1, n).expand();
-    clauses.push_back(gen_not_one_clause);
+    Input_Not_Equals_Number(context, generator, 1, n).expand(out);
     
     // PowMod_NBit for (generator ** pow) % mod
-    PowMod_NBit powmod_op(generator, pow, mod, "FermatTest3_" + Z(call_count), n);
-    auto powmod_clauses = powmod_op.expand();
-    clauses.insert(clauses.end(), powmod_clauses.begin(), powmod_clauses.end());
+    PowMod_NBit powmod_op(context, generator, pow, mod, context.sym("FermatTest3")[call_count], n);
+    powmod_op.expand(out);
     
     // Input_Not_Equals_Number for result != 1
-    auto result_not_one_clause = Input_Not_Equals_Number("FermatTest3_" + Z(call_count), 1, n).expand();
-    clauses.push_back(result_not_one_clause);
+    Input_Not_Equals_Number(context, context.sym("FermatTest3")[call_count], 1, n).expand(out);
     
-    return clauses;
 } 
\ No newline at end of file
@@ -1,429 +1,1046 @@
 // core.hpp - Core logic for CNF generation and arithmetic/logic operations for SAT-based number theory problems.
 //
 // This file defines classes for encoding arithmetic, logic, and number-theoretic constraints as CNF clauses.
-// Each class provides an expand() method to generate CNF clauses for a specific operation or property.
+// Each class provides an expand(ClauseSink&) method that pushes the CNF clauses for a specific operation
+// or property straight into a caller-supplied sink (in-memory, counting, file or hashing).
 //
 #pragma once
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <initializer_list>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <utility>
+#include <span>
+#include <string_view>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
 // Returns a zero-padded string representation of an integer (used for variable naming)
 std::string Z(int i);
 
+// Signed DIMACS-style literal: +id for a variable, -id for its negation
+using Literal = int;
+
+// A single CNF clause as a list of literals (without the terminating 0)
+using Clause = std::vector<Literal>;
+
+// Contiguous, geometrically grown buffer of trivially copyable values; storage is released all at once
+template <typename T>
+class Arena {
+    static_assert(std::is_trivially_copyable_v<T>, "Arena holds trivially copyable values only");
+private:
+    T* items = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+public:
+    Arena() = default;
+    Arena(const Arena& other) { *this = other; }
+    Arena(Arena&& other) noexcept
+        : items(other.items), count(other.count), capacity(other.capacity) {
+        other.items = nullptr;
+        other.count = other.capacity = 0;
+    }
+    Arena& operator=(const Arena& other) {
+        if (this != &other) {
+            count = 0;
+            reserve(other.count);
+            if (other.count > 0) {
+                std::memcpy(items, other.items, other.count * sizeof(T));
+            }
+            count = other.count;
+        }
+        return *this;
+    }
+    Arena& operator=(Arena&& other) noexcept {
+        if (this != &other) {
+            std::free(items);
+            items = other.items;
+            count = other.count;
+            capacity = other.capacity;
+            other.items = nullptr;
+            other.count = other.capacity = 0;
+        }
+        return *this;
+    }
+    ~Arena() { std::free(items); }
+
+    void reserve(size_t wanted) {
+        if (wanted <= capacity) {
+            return;
+        }
+        size_t grown = capacity < 64 ? 64 : capacity * 2;
+        if (grown < wanted) {
+            grown = wanted;
+        }
+        T* moved = static_cast<T*>(std::realloc(items, grown * sizeof(T)));
+        if (moved == nullptr) {
+            throw std::bad_alloc();
+        }
+        items = moved;
+        capacity = grown;
+    }
+    // Returns room for k consecutive values at the end of the buffer
+    T* allocate(size_t k) {
+        reserve(count + k);
+        T* slot = items + count;
+        count += k;
+        return slot;
+    }
+    void push_back(T value) { *allocate(1) = value; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    size_t size() const { return count; }
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    void release() {
+        std::free(items);
+        items = nullptr;
+        count = capacity = 0;
+    }
+};
+
+// Receiver of emitted clauses; gadgets push every clause straight into a sink
+class ClauseSink {
+public:
+    virtual ~ClauseSink() = default;
+    virtual void add(std::span<const Literal> clause) = 0;
+    // Identifies the guard under which clauses are added: 0 when unguarded,
+    // otherwise a digest of the literals prefixed by PrefixLiteralSink adaptors
+    virtual unsigned long long scope() const { return 0; }
+    // The sink at the end of the adaptor chain, where clauses are added unguarded
+    virtual ClauseSink& root() { return *this; }
+    // Reports that the clauses of a gate make output a function of inputs (used to order variables)
+    virtual void define(Literal /*output*/, std::span<const Literal> /*inputs*/) {}
+    // A guarded clause on its way to the root, with the scope of the sink it was added to
+    virtual void add_scoped(std::span<const Literal> clause, unsigned long long /*scope*/) { add(clause); }
+    void add(std::initializer_list<Literal> clause) {
+        add(std::span<const Literal>(clause.begin(), clause.size()));
+    }
+    void add(const Clause& clause) { add(std::span<const Literal>(clause)); }
+};
+
+// Sink that only counts clauses and literals and tracks the largest variable id
+class CountingSink : public ClauseSink {
+private:
+    size_t clauses = 0;
+    size_t literals = 0;
+    int max_var = 0;
+public:
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override;
+    size_t clause_count() const { return clauses; }
+    size_t literal_count() const { return literals; }
+    int max_variable() const { return max_var; }
+};
+
+// Sink that writes each clause as a DIMACS line, optionally renumbering ids through literal_map
+class FileSink : public ClauseSink {
+private:
+    std::ostream& stream;
+    const std::vector<int>* literal_map;
+public:
+    FileSink(std::ostream& stream, const std::vector<int>* literal_map = nullptr);
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override;
+};
+
+// Sink that folds the clause stream into a 64-bit FNV-1a digest (clause order and literal order matter),
+// optionally renumbering ids through literal_map first
+class HashingSink : public ClauseSink {
+private:
+    const std::vector<int>* literal_map;
+    unsigned long long state = 14695981039346656037ULL;
+    size_t clauses = 0;
+    void mix(unsigned int word);
+public:
+    explicit HashingSink(const std::vector<int>* literal_map = nullptr) : literal_map(literal_map) {}
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override;
+    // Folds one symbol-table entry (a name and its variable number) into the digest
+    void add_name(std::string_view name, int id);
+    unsigned long long digest() const { return state; }
+    size_t clause_count() const { return clauses; }
+};
+
+// Sink that writes each clause in the binary CNF format (see write_cnf in core.cpp): the clause
+// length and the literals, sorted by variable, as varints of (variable delta << 1 | negated)
+class BinarySink : public ClauseSink {
+private:
+    std::ostream& stream;
+    const std::vector<int>* literal_map;
+    Clause scratch;
+    std::string bytes;
+public:
+    BinarySink(std::ostream& stream, const std::vector<int>* literal_map = nullptr);
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override;
+};
+
+// Sink adaptor that prepends a fixed literal to every clause before forwarding it
+class PrefixLiteralSink : public ClauseSink {
+private:
+    Literal literal;
+    ClauseSink& next;
+    Clause scratch;
+    unsigned long long guard;
+public:
+    PrefixLiteralSink(Literal literal, ClauseSink& next);
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override { add_scoped(clause, guard); }
+    void add_scoped(std::span<const Literal> clause, unsigned long long scope) override;
+    unsigned long long scope() const override { return guard; }
+    ClauseSink& root() override { return next.root(); }
+    void define(Literal output, std::span<const Literal> inputs) override { next.define(output, inputs); }
+};
+
+// In-memory sink: every literal lives in one contiguous arena, clause i spans
+// literals[offsets[i] .. offsets[i + 1]) and is read back as a span without copying
+class ClauseDatabase : public ClauseSink {
+private:
+    Arena<Literal> literals;
+    Arena<size_t> offsets;
+public:
+    ClauseDatabase() { offsets.push_back(0); }
+    void reserve(size_t clause_count, size_t literal_count) {
+        offsets.reserve(clause_count + 1);
+        literals.reserve(literal_count);
+    }
+    // Appends an uninitialised clause of k literals and returns it for the caller to fill
+    Literal* append_clause(size_t k) {
+        Literal* clause = literals.allocate(k);
+        offsets.push_back(literals.size());
+        return clause;
+    }
+    using ClauseSink::add;
+    void add(std::span<const Literal> clause) override {
+        std::copy(clause.begin(), clause.end(), append_clause(clause.size()));
+    }
+    void append(const ClauseDatabase& other);
+    // Replays the stored clauses into another sink
+    void expand(ClauseSink& out) const;
+    size_t size() const { return offsets.size() - 1; }
+    size_t literal_count() const { return literals.size(); }
+    std::span<const Literal> operator[](size_t i) const {
+        return {literals.data() + offsets[i], literals.data() + offsets[i + 1]};
+    }
+    // Frees every clause at once
+    void clear();
+};
+
+// A deferred condition: emits its clauses into the given sink when called
+using ClauseEmitter = std::function<void(ClauseSink&)>;
+
+// Wraps a gadget (or a ClauseDatabase) as a ClauseEmitter; the gadget must outlive the emitter
+template <typename Gadget>
+ClauseEmitter emitter(const Gadget& gadget) {
+    return [&gadget](ClauseSink& sink) { gadget.expand(sink); };
+}
+
+// A constraint that has not been turned into clauses yet; expand() emits its clauses on demand
+class ExpandableCondition {
+public:
+    virtual ~ExpandableCondition() = default;
+    virtual void expand(ClauseSink& out) const = 0;
+};
+
+// Wraps a condition shared through the DAG as a ClauseEmitter; the emitter keeps it alive
+inline ClauseEmitter emitter(std::shared_ptr<const ExpandableCondition> condition) {
+    return [condition](ClauseSink& sink) { condition->expand(sink); };
+}
+
+class VariableRegistry;
+
+// Handle to a hierarchical variable name: a root label followed by index or label segments,
+// e.g. context.sym("AddNBit")[3]["carry_out"][0] names <AddNBit_0000000003_carry_out_0000000000>
+class Sym {
+private:
+    VariableRegistry* registry;
+    int node;
+public:
+    Sym(VariableRegistry* registry, int node);
+    Sym operator[](int index) const;
+    Sym operator[](const char* label) const;
+    Literal var() const;
+};
+
+// Registry of scoped variable names; hands out variable ids in O(1) and formats names only on request
+class VariableRegistry {
+private:
+    struct Node {
+        int parent;
+        int segment;    // index >= 0, or -(label id + 1) for a label segment
+        int var;
+    };
+    std::vector<Node> nodes;
+    std::vector<std::string> labels;
+    std::unordered_map<std::string, int> label_ids;
+    std::vector<unsigned long long> slot_keys;
+    std::vector<int> slot_nodes;
+    std::vector<int> var_nodes;
+    void grow();
+public:
+    VariableRegistry();
+    int label(const std::string& text);
+    int child(int parent, int segment);
+    Literal var(int node);
+    std::string name(int var) const;
+    char initial(int var) const;
+    int instance(int var) const;
+    int size() const;
+    std::vector<int> name_order(const std::vector<char>& used) const;
+    void clear();
+};
+
+// Returns the (positive) literal of the named variable, registering it on first use
+Literal var(const Sym& name);
+
+// How write_cnf numbers the variables of the output (--numbering=...)
+enum class VariableNumbering {
+    Name,           // lowercase (user) names first, sorted by name within each group (default)
+    FirstUse,       // in order of first occurrence in the clause stream
+    Topological,    // gate inputs before the gate output, cones in first-use order
+    Instance        // grouped by gadget instance, groups and members in first-use order
+};
+
+// Order of the clauses in the output (--clause-order=...)
+enum class ClauseOrder {
+    Emit,           // as the gadgets emit them (default)
+    Variables,      // by the largest variable number of each clause, held in memory to sort
+    Canonical       // literals sorted within each clause, clauses sorted, held in memory to sort
+};
+
+// Circuit Mul_NBit builds (--multiplier=...)
+enum class MultiplierStrategy {
+    Array,          // one shifted partial product per bit, ripple-added in full width (default)
+    Wallace,        // carry-save Wallace tree over the partial-product bits, then one ripple pass
+    Dadda,          // Dadda tree: only as many adders per stage as the height schedule needs
+    Karatsuba       // Karatsuba split down to 16-bit halves, each multiplied by a Dadda tree
+};
+
+// Carry network of Add_NBit (--adder=...)
+enum class AdderStrategy {
+    Ripple,         // chain of Add_1Bit full adders, n carry steps (default)
+    KoggeStone,     // parallel prefix, log2(n) levels, every node merged at every level
+    BrentKung,      // parallel prefix, 2 log2(n) - 1 levels, about 2n merges
+    Sklansky        // parallel prefix, log2(n) levels, n/2 merges per level (fan-out up to n/2)
+};
+
+// How PowMod_NBit reduces its products (--modmul=...)
+enum class ModularMultiplication {
+    Divide,         // 2N-bit Mul_NBit / Square_NBit followed by a 2N-bit DivMod_NBit (default)
+    Interleaved     // ModMul_NBit: interleaved shift-and-reduce at N + 1 bits
+};
+
+// Per-build generation options
+struct GenerationOptions {
+    bool progress = true;               // report progress on stderr while writing
+    bool structural_hashing = false;    // share identical gates, constant comparisons and or-conditions (--structural-hashing)
+    bool constant_propagation = false;  // fold gates over literals fixed by unit clauses (--constant-propagation)
+    bool alias_equalities = false;      // map both sides of an unguarded Equals_NBit to one variable (--alias-equalities)
+    unsigned threads = 0;               // worker threads of the parallel stages, 0 = one per core (--threads=N)
+    bool binary = false;                // write the binary CNF format plus a ".sym" symbol file (--binary)
+    std::string compression;            // "gz" or "xz": compress the output file (--compress=gz|xz)
+    bool symbol_map = false;            // write the names to an indexed ".symbols" file, not "cv" lines (--symbol-map)
+    bool user_symbols_only = false;     // list only the lowercase (user) names (--user-symbols)
+    VariableNumbering numbering = VariableNumbering::Name;
+    ClauseOrder clause_order = ClauseOrder::Emit;
+    bool verify_digest = false;         // print a digest of the written formula (--verify-digest)
+    MultiplierStrategy multiplier = MultiplierStrategy::Array;
+    bool symmetric_square = false;      // array Square_NBit with n(n-1)/2 partial products (--symmetric-square)
+    AdderStrategy adder = AdderStrategy::Ripple;
+    bool increment_chain = false;       // build Inc_NBit / Dec_NBit as half-adder chains (--increment-chain)
+    ModularMultiplication modmul = ModularMultiplication::Divide;
+};
+
+// Strips the generation options (e.g. --structural-hashing) from argv into options and
+// returns the remaining arguments; unknown "--" arguments are returned unchanged
+std::vector<std::string> parse_generation_options(int argc, char* argv[], GenerationOptions& options);
+
+// Per-build state threaded through every gadget: the variable registry, the instance counters
+// that scope auxiliary variable names, and the options. Builds with separate contexts share no
+// mutable state, so several CNFs can be generated concurrently, each from a clean start.
+class GenerationContext {
+public:
+    // Structural key of a gate or comparison: a kind tag, the guard scope and the operand literals
+    using GateKey = std::vector<int>;
+private:
+    struct GateKeyHash {
+        size_t operator()(const GateKey& key) const;
+    };
+    VariableRegistry registry;
+    std::vector<int> counters;
+    std::unordered_map<GateKey, Literal, GateKeyHash> gates;
+    std::unordered_map<GateKey, Literal, GateKeyHash> previous_gates;
+    std::vector<signed char> constants;
+    std::vector<int> alias_parent;
+    std::vector<int> alias_size;
+    size_t alias_merges = 0;
+    std::vector<unsigned long long> scopes;           // per variable, while expanding
+    std::vector<unsigned long long> previous_scopes;  // per variable, of the last complete expansion
+    static size_t allocate_counter_slot();
+public:
+    GenerationOptions options;
+
+    GenerationContext() = default;
+    explicit GenerationContext(const GenerationOptions& options);
+    GenerationContext(const GenerationContext&) = delete;
+    GenerationContext& operator=(const GenerationContext&) = delete;
+
+    VariableRegistry& variables() { return registry; }
+    const VariableRegistry& variables() const { return registry; }
+    // Root of a variable name in this build, e.g. context.sym("AddNBit")[3]["carry_out"][0]
+    Sym sym(const std::string& label);
+
+    // Instance counter of one gadget type
+    template <typename Gadget>
+    int& counter() {
+        static const size_t slot = allocate_counter_slot();
+        if (slot >= counters.size()) {
+            counters.resize(slot + 1, 0);
+        }
+        return counters[slot];
+    }
+    // Returns the next instance number (1, 2, ...) of a gadget type
+    template <typename Gadget>
+    int next_instance() { return ++counter<Gadget>(); }
+
+    // Snapshot and rewind of every counter, so a constraint can be expanded again under the same names
+    std::vector<int> save_counters() const { return counters; }
+    void restore_counters(const std::vector<int>& saved);
+
+    // Structural hashing table: the literal recorded for an identical gate, or 0 if there is none
+    Literal find_gate(const GateKey& key) const;
+    void record_gate(const GateKey& key, Literal output);
+    // The literal recorded for key during the previous expansion of the formula, or 0
+    Literal find_previous_gate(const GateKey& key) const;
+    // Forgets every recorded gate (keeping them for find_previous_gate); called whenever a
+    // formula is expanded from the start
+    void clear_gates();
+
+    // Constant propagation table: +1 when literal is known to be true, -1 when it is known to be false, 0 otherwise
+    int constant(Literal literal) const {
+        literal = representative(literal);
+        const size_t id = static_cast<size_t>(literal < 0 ? -literal : literal);
+        if (id >= constants.size() || constants[id] == 0) {
+            return 0;
+        }
+        return (literal < 0) ? -constants[id] : constants[id];
+    }
+    // Records literal as true; returns false when its variable already had a value
+    bool fix(Literal literal);
+    void clear_constants() { constants.clear(); }
+
+    // Variable aliasing: the literal of the variable that stands for literal's whole equality class
+    Literal representative(Literal literal) const {
+        int id = literal < 0 ? -literal : literal;
+        if (static_cast<size_t>(id) >= alias_parent.size()) {
+            return literal;
+        }
+        while (alias_parent[id] != id) {
+            id = alias_parent[id];
+        }
+        return literal < 0 ? -id : id;
+    }
+    // Merges the equality classes of two variables; returns false when they were already merged
+    bool alias(Literal a, Literal b);
+    // Number of merges so far
+    size_t alias_count() const { return alias_merges; }
+    
+    // Guard scopes of the variables (options.structural_hashing): record_scope notes that literal
+    // occurs in a clause added under scope; finish_scope_pass ends an expansion of the formula and
+    // returns whether its scopes differ from those of the previous one; only_in_scope tells
+    // whether, in the last complete expansion, every clause with literal was added under scope
+    void record_scope(Literal literal, unsigned long long scope);
+    bool finish_scope_pass();
+    bool only_in_scope(Literal literal, unsigned long long scope) const;
+};
+
+// Ordered set of un-expanded constraints, expanded only when a sink asks for them.
+// A condition added more than once (or shared between entries) is emitted once.
+// The context's gadget counters are rewound before each expansion, so every call emits the same clauses
+// under the same variable names; add all conditions before the first expand().
+// With options.constant_propagation the first expand() first finds the fixed literals (see core.cpp).
+class ConstraintDag {
+private:
+    GenerationContext& build;
+    std::vector<std::shared_ptr<const ExpandableCondition>> roots;
+    mutable std::vector<int> start_counters;
+    mutable bool expanded = false;
+    void expand_roots(ClauseSink& out) const;
+public:
+    explicit ConstraintDag(GenerationContext& context);
+    GenerationContext& context() const { return build; }
+    // Constructs a condition in this DAG's context (the context is passed as the first argument)
+    template <typename Condition, typename... Args>
+    std::shared_ptr<const Condition> add(Args&&... args) {
+        auto condition = std::make_shared<const Condition>(build, std::forward<Args>(args)...);
+        roots.push_back(condition);
+        return condition;
+    }
+    void add(std::shared_ptr<const ExpandableCondition> condition);
+    std::vector<std::shared_ptr<const ExpandableCondition>>& conditions() { return roots; }
+    const std::vector<std::shared_ptr<const ExpandableCondition>>& conditions() const { return roots; }
+    size_t size() const { return roots.size(); }
+    void expand(ClauseSink& out) const;
+};
+
+// Constraint: a single fixed clause
+class ClauseCondition : public ExpandableCondition {
+private:
+    Clause clause;
+public:
+    ClauseCondition(GenerationContext& context, Clause clause);
+    void expand(ClauseSink& out) const override;
+};
+
+
 // Constraint: input == value (bitwise equality)
-class Input_Equals_Number {
+class Input_Equals_Number : public ExpandableCondition {
 private:
-    std::string input;
+    GenerationContext& context;
+    Sym input;
     int value;
     int n;
 public:
-    Input_Equals_Number(const std::string& input, int value, int n);
-    std::vector<std::string> expand() const;
+    Input_Equals_Number(GenerationContext& context, const Sym& input, int value, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: input != value (bitwise inequality)
-class Input_Not_Equals_Number {
+class Input_Not_Equals_Number : public ExpandableCondition {
 private:
-    std::string input;
+    GenerationContext& context;
+    Sym input;
     int value;
     int n;
 public:
-    Input_Not_Equals_Number(const std::string& input, int value, int n);
-    std::string expand() const;
+    Input_Not_Equals_Number(GenerationContext& context, const Sym& input, int value, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: carry_out == (popcount(in_a, in_b, carry_in) >= 2)
-class CarryOut_Equal_POPCNT_GREATER_THAN_2 {
+class CarryOut_Equal_POPCNT_GREATER_THAN_2 : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string carry_in;
-    std::string carry_out;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym carry_in;
+    Sym carry_out;
 public:
-    CarryOut_Equal_POPCNT_GREATER_THAN_2(const std::string& in_a, const std::string& in_b, 
-                                        const std::string& carry_in, const std::string& carry_out);
-    std::vector<std::string> expand() const;
+    CarryOut_Equal_POPCNT_GREATER_THAN_2(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                                        const Sym& carry_in, const Sym& carry_out);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == in_a ^ in_b ^ carry_in (1-bit addition result)
-class Result_Equal_A_XOR_B_XOR_CarryIn {
+class Result_Equal_A_XOR_B_XOR_CarryIn : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string carry_in;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym carry_in;
+    Sym result;
 public:
-    Result_Equal_A_XOR_B_XOR_CarryIn(const std::string& in_a, const std::string& in_b, 
-                                     const std::string& carry_in, const std::string& result);
-    std::vector<std::string> expand() const;
+    Result_Equal_A_XOR_B_XOR_CarryIn(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                                     const Sym& carry_in, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: 1-bit full adder (in_a + in_b + carry_in == (result, carry_out))
-class Add_1Bit {
+class Add_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string carry_in;
-    std::string result;
-    std::string carry_out;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym carry_in;
+    Sym result;
+    Sym carry_out;
 public:
-    Add_1Bit(const std::string& in_a, const std::string& in_b, 
-             const std::string& carry_in, const std::string& result, const std::string& carry_out);
-    std::vector<std::string> expand() const;
+    Add_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+             const Sym& carry_in, const Sym& result, const Sym& carry_out);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit adder (in_a + in_b == result, with overflow)
-class Add_NBit {
+class Add_NBit : public ExpandableCondition {
+private:
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
+    Sym over_flow;
+    int n;
+    // Kogge-Stone, Brent-Kung and Sklansky carry networks (options.adder)
+    void expand_prefix(ClauseSink& out, int call_count) const;
+public:
+    Add_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+             const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
+};
+
+// Constraint: n-bit increment (in_a + 1 == result, with overflow)
+class Inc_NBit : public ExpandableCondition {
+private:
+    GenerationContext& context;
+    Sym in_a;
+    Sym result;
+    Sym over_flow;
+    int n;
+public:
+    Inc_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
+};
+
+// Constraint: n-bit decrement (in_a - 1 == result, with over_flow set when in_a == 0)
+class Dec_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    std::string over_flow;
+    GenerationContext& context;
+    Sym in_a;
+    Sym result;
+    Sym over_flow;
     int n;
-    static int call_count;
 public:
-    Add_NBit(const std::string& in_a, const std::string& in_b, 
-             const std::string& result, const std::string& over_flow, int n);
-    std::vector<std::string> expand() const;
+    Dec_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: (in_a * in_b) << shift == result (partial product for multiplication)
-class Mul_NBit_1Bit_Shift {
+class Mul_NBit_1Bit_Shift : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
     int shift;
     int n;
-    static int call_count;
 public:
-    Mul_NBit_1Bit_Shift(const std::string& in_a, const std::string& in_b, 
-                        const std::string& result, int shift, int n);
-    std::vector<std::string> expand() const;
+    Mul_NBit_1Bit_Shift(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                        const Sym& result, int shift, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit multiplier (in_a * in_b == result, with overflow)
-class Mul_NBit {
+class Mul_NBit : public ExpandableCondition {
+private:
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
+    Sym over_flow;
+    int n;
+    // Wallace, Dadda and Karatsuba circuits (options.multiplier)
+    void expand_tree(ClauseSink& out, int call_count) const;
+public:
+    Mul_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+             const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
+};
+
+// Constraint: n-bit squaring (in_a * in_a == result, with overflow)
+class Square_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    std::string over_flow;
+    GenerationContext& context;
+    Sym in_a;
+    Sym result;
+    Sym over_flow;
     int n;
-    static int call_count;
+    // Symmetric shift-and-add rows (options.symmetric_square with the array multiplier)
+    void expand_array(ClauseSink& out, int call_count) const;
 public:
-    Mul_NBit(const std::string& in_a, const std::string& in_b, 
-             const std::string& result, const std::string& over_flow, int n);
-    std::vector<std::string> expand() const;
+    Square_NBit(GenerationContext& context, const Sym& in_a, const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit multiplication by a single bit (in_a * in_b == result)
-class Mul_NBit_1Bit {
+class Mul_NBit_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
     int n;
-    static int call_count;
 public:
-    Mul_NBit_1Bit(const std::string& in_a, const std::string& in_b, 
-                  const std::string& result, int n);
-    std::vector<std::string> expand() const;
+    Mul_NBit_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                  const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: Encodes primality of a number using number-theoretic CNF
-class IsPrime {
+class IsPrime : public ExpandableCondition {
 private:
-    std::string target;
+    GenerationContext& context;
+    Sym target;
     int n;
     int num_prime;
-    static int call_count;
 
 public:
-    IsPrime(const std::string& target, int n, int num_prime );
-    std::vector<std::string> expand() const;
+    IsPrime(GenerationContext& context, const Sym& target, int n, int num_prime );
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: Encodes compositeness of a number using number-theoretic CNF
-class IsComposite {
+class IsComposite : public ExpandableCondition {
 private:
-    std::string target;
+    GenerationContext& context;
+    Sym target;
     int n;
 public:
-    IsComposite(const std::string& target, int n);
-    std::vector<std::string> expand() const;
+    IsComposite(GenerationContext& context, const Sym& target, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == in_a & in_b (bitwise AND)
-class And_1Bit {
+class And_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    static int call_count;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
 public:
-    And_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result);
-    std::vector<std::string> expand() const;
+    And_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == (in_a < in_b) (1-bit less-than)
-class LessThan_1Bit {
+class LessThan_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    static int call_count;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
 public:
-    LessThan_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result);
-    std::vector<std::string> expand() const;
+    LessThan_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == (in_a == in_b) (1-bit equality)
-class Equals_1Bit {
+class Equals_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    static int call_count;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
 public:
-    Equals_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result);
-    std::vector<std::string> expand() const;
+    Equals_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit equality (in_a == in_b)
-class Equals_NBit {
+class Equals_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
     int n;
-    static int call_count;
 public:
-    Equals_NBit(const std::string& in_a, const std::string& in_b, int n);
-    std::vector<std::string> expand() const;
+    Equals_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit less-than (in_a < in_b)
-class LessThan_NBit {
+class LessThan_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
     int n;
-    static int call_count;
 public:
-    LessThan_NBit(const std::string& in_a, const std::string& in_b, int n);
-    std::vector<std::string> expand() const;
+    LessThan_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: n-bit division and modulo (in_a == in_b * div + mod)
-class DivMod_NBit {
+class DivMod_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string div;
-    std::string mod;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym div;
+    Sym mod;
     int n;
-    static int call_count;
 public:
-    DivMod_NBit(const std::string& in_a, const std::string& in_b, 
-                const std::string& div, const std::string& mod, int n);
-    std::vector<std::string> expand() const;
+    DivMod_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                const Sym& div, const Sym& mod, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == if cond then a else b (1-bit conditional)
-class If_Cond_A_Else_B_1Bit {
+class If_Cond_A_Else_B_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string cond;
-    std::string result;
-    static int call_count;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym cond;
+    Sym result;
 public:
-    If_Cond_A_Else_B_1Bit(const std::string& in_a, const std::string& in_b, 
-                          const std::string& cond, const std::string& result);
-    std::vector<std::string> expand() const;
+    If_Cond_A_Else_B_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                          const Sym& cond, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == if cond then a else b (n-bit conditional)
-class If_Cond_A_Else_B_NBit {
+class If_Cond_A_Else_B_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string cond;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym cond;
+    Sym result;
     int n;
-    static int call_count;
 public:
-    If_Cond_A_Else_B_NBit(const std::string& in_a, const std::string& in_b, 
-                          const std::string& cond, const std::string& result, int n);
-    std::vector<std::string> expand() const;
+    If_Cond_A_Else_B_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, 
+                          const Sym& cond, const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == in_a | in_b (bitwise OR)
-class Or_1Bit {
+class Or_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
 public:
-    Or_1Bit(const std::string& in_a, const std::string& in_b, const std::string& result);
-    std::vector<std::string> expand() const;
+    Or_1Bit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == OR of n input bits
-class Or_NBit_To_1Bit {
+class Or_NBit_To_1Bit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym result;
     int n;
 public:
-    Or_NBit_To_1Bit(const std::string& in_a, const std::string& result, int n);
-    std::vector<std::string> expand() const;
+    Or_NBit_To_1Bit(GenerationContext& context, const Sym& in_a, const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == in_a ** in_b (n-bit exponentiation)
-class Pow_NBit {
+class Pow_NBit : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string in_b;
-    std::string result;
-    std::string over_flow;
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym result;
+    Sym over_flow;
     int n;
 public:
-    Pow_NBit(const std::string& in_a, const std::string& in_b, const std::string& result, const std::string& over_flow, int n);
-    std::vector<std::string> expand() const;
+    Pow_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& result, const Sym& over_flow, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result[0...n] == in_a, result[n...(2*n)] == 0 (zero-extended assignment)
-class DoubleSize_Assign {
+class DoubleSize_Assign : public ExpandableCondition {
 private:
-    std::string in_a;
-    std::string result;
+    GenerationContext& context;
+    Sym in_a;
+    Sym result;
     int n;
 public:
-    DoubleSize_Assign(const std::string& in_a, const std::string& result, int n);
-    std::vector<std::string> expand() const;
+    DoubleSize_Assign(GenerationContext& context, const Sym& in_a, const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
+};
+
+// Constraint: n-bit modular multiplication (result == (in_a * in_b) % mod, for in_a < mod)
+class ModMul_NBit : public ExpandableCondition {
+private:
+    GenerationContext& context;
+    Sym in_a;
+    Sym in_b;
+    Sym mod;
+    Sym result;
+    int n;
+public:
+    ModMul_NBit(GenerationContext& context, const Sym& in_a, const Sym& in_b, const Sym& mod,
+                const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: result == (base ** exp) % mod (modular exponentiation)
-class PowMod_NBit {
+class PowMod_NBit : public ExpandableCondition {
 private:
-    std::string base;
-    std::string exp;
-    std::string mod;
-    std::string result;
+    GenerationContext& context;
+    Sym base;
+    Sym exp;
+    Sym mod;
+    Sym result;
     int n;
+    // ModMul_NBit at N bits (options.modmul)
+    void expand_interleaved(ClauseSink& out, int call_count) const;
 public:
-    PowMod_NBit(const std::string& base, const std::string& exp, const std::string& mod, const std::string& result, int n);
-    std::vector<std::string> expand() const;
+    PowMod_NBit(GenerationContext& context, const Sym& base, const Sym& exp, const Sym& mod, const Sym& result, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Utility: Adds a literal to all clauses in a condition
-class AddLiteralToCondition {
+class AddLiteralToCondition : public ExpandableCondition {
 private:
-    std::string literal;
-    std::vector<std::string> condition;
+    GenerationContext& context;
+    Literal literal;
+    ClauseEmitter condition;
 public:
-    AddLiteralToCondition(const std::string& literal, const std::vector<std::string>& condition);
-    std::vector<std::string> expand() const;
+    AddLiteralToCondition(GenerationContext& context, Literal literal, ClauseEmitter condition);
+    void expand(ClauseSink& out) const override;
 };
 
 // Utility: Logical OR of two CNF conditions
-class Or_Condition {
+class Or_Condition : public ExpandableCondition {
 private:
-    std::vector<std::string> condition1;
-    std::vector<std::string> condition2;
+    GenerationContext& context;
+    ClauseEmitter condition1;
+    ClauseEmitter condition2;
+    int instance;
 
 public:
-    Or_Condition(const std::vector<std::string>& condition1,
-                 const std::vector<std::string>& condition2);
-    std::vector<std::string> expand() const;
+    Or_Condition(GenerationContext& context, ClauseEmitter condition1,
+                 ClauseEmitter condition2);
+    void expand(ClauseSink& out) const override;
 };
 
 // Utility: Logical AND of two CNF conditions
-class And_Condition {
+class And_Condition : public ExpandableCondition {
 private:
-    std::vector<std::string> condition1;
-    std::vector<std::string> condition2;
+    GenerationContext& context;
+    ClauseEmitter condition1;
+    ClauseEmitter condition2;
 
 public:
-    And_Condition(const std::vector<std::string>& condition1,
-                  const std::vector<std::string>& condition2);
-    std::vector<std::string> expand() const;
+    And_Condition(GenerationContext& context, ClauseEmitter condition1,
+                  ClauseEmitter condition2);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: output == sum of data_count n-bit inputs
-class Sum_NBit {
+class Sum_NBit : public ExpandableCondition {
 private:
-    std::string input;
-    std::string output;
-    std::string overflow;
+    GenerationContext& context;
+    Sym input;
+    Sym output;
+    Sym overflow;
     int data_count;
     int bits;
 
 public:
-    Sum_NBit(const std::string& input, const std::string& output,
-             const std::string& overflow, int data_count, int bits);
-    std::vector<std::string> expand() const;
+    Sum_NBit(GenerationContext& context, const Sym& input, const Sym& output,
+             const Sym& overflow, int data_count, int bits);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: output == product of data_count n-bit inputs
-class Product_NBit {
+class Product_NBit : public ExpandableCondition {
 private:
-    std::string input;
-    std::string output;
-    std::string overflow;
+    GenerationContext& context;
+    Sym input;
+    Sym output;
+    Sym overflow;
     int data_count;
     int bits;
-    static int call_count;
 
 public:
-    Product_NBit(const std::string& input, const std::string& output,
-                 const std::string& overflow, int data_count, int bits);
-    std::vector<std::string> expand() const;
+    Product_NBit(GenerationContext& context, const Sym& input, const Sym& output,
+                 const Sym& overflow, int data_count, int bits);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: Fermat's little theorem test (generator^pow % mod == 1)
-class FermatTest {
+class FermatTest : public ExpandableCondition {
 private:
-    std::string generator;
-    std::string pow;
-    std::string mod;
+    GenerationContext& context;
+    Sym generator;
+    Sym pow;
+    Sym mod;
     int n;
-    static int call_count;
 
 public:
-    FermatTest(const std::string& generator, const std::string& pow, 
-               const std::string& mod, int n);
-    std::vector<std::string> expand() const;
+    FermatTest(GenerationContext& context, const Sym& generator, const Sym& pow, 
+               const Sym& mod, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: Fermat's test for prime-1 (generator^(prime-1) % prime == 1)
-class FermatTest2 {
+class FermatTest2 : public ExpandableCondition {
 private:
-    std::string generator;
-    std::string prime;
+    GenerationContext& context;
+    Sym generator;
+    Sym prime;
     int n;
-    static int call_count;
 
 public:
-    FermatTest2(const std::string& generator, const std::string& prime, int n);
-    std::vector<std::string> expand() const;
+    FermatTest2(GenerationContext& context, const Sym& generator, const Sym& prime, int n);
+    void expand(ClauseSink& out) const override;
 };
 
 // Constraint: Fermat's test for non-1 (generator^pow % mod != 1)
-class FermatTest3 {
+class FermatTest3 : public ExpandableCondition {
 private:
-    std::string generator;
-    std::string pow;
-    std::string mod;
+    GenerationContext& context;
+    Sym generator;
+    Sym pow;
+    Sym mod;
     int n;
-    static int call_count;
 
 public:
-    FermatTest3(const std::string& generator, const std::string& pow, 
-                const std::string& mod, int n);
-    std::vector<std::string> expand() const;
+    FermatTest3(GenerationContext& context, const Sym& generator, const Sym& pow, 
+                const Sym& mod, int n);
+    void expand(ClauseSink& out) const override;
+};
+
+// Generates a CNF file from a set of integer-literal clauses (variable names come from the context)
+void generate_cnf(const GenerationContext& context, const ClauseDatabase& conditions, const std::string& file_path);
+
+// Generates a CNF file from a constraint DAG, expanding it while the file is written
+void generate_cnf(const ConstraintDag& conditions, const std::string& file_path);
+
+// Output file of a driver: stem + ".bcnf" with options.binary, stem + ".cnf" otherwise, plus
+// "." + options.compression when set (the writers compress .gz and .xz files on the fly)
+std::string cnf_file_name(const std::string& stem, const GenerationOptions& options);
+
+// Converts a binary CNF file (and its ".sym" symbol file, when present) to DIMACS text;
+// returns false when a file cannot be opened or the input is malformed
+bool binary_cnf_to_dimacs(const std::string& binary_path, const std::string& dimacs_path);
+
+// Read-only view of a ".symbols" file written with --symbol-map. The file is memory-mapped and
+// both lookups are binary searches: by name over the name-sorted entries, by id over an id index
+class SymbolMap {
+public:
+    struct Entry {
+        unsigned long long name_offset;
+        unsigned int name_length;
+        int id;
+    };
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    size_t count = 0;
+    const Entry* entries = nullptr;
+    const unsigned int* by_id = nullptr;
+    const char* names = nullptr;
+public:
+    SymbolMap() = default;
+    SymbolMap(const SymbolMap&) = delete;
+    SymbolMap& operator=(const SymbolMap&) = delete;
+    ~SymbolMap() { close(); }
+    // Maps the file; returns false when it cannot be read or is not a symbol map
+    bool open(const std::string& file_path);
+    void close();
+    size_t size() const { return count; }
+    std::string_view name_at(size_t i) const { return {names + entries[i].name_offset, entries[i].name_length}; }
+    int id_at(size_t i) const { return entries[i].id; }
+    // DIMACS id of a name (without the angle brackets), or 0 when it is not listed
+    int id(std::string_view name) const;
+    // First listed name (in name order) with the given id, or an empty view
+    std::string_view name(int id) const;
 };
 
-// Generates a CNF file from a set of conditions
-void generate_cnf(const std::vector<std::string>& conditions, const std::string& file_path); 
\ No newline at end of file
+// Generates a CNF file from a set of "<name>"-style string clauses, scanning them on options.threads threads
+void generate_cnf(const std::vector<std::string>& conditions, const std::string& file_path,
+                  const GenerationOptions& options = GenerationOptions()); 
\ No newline at end of file
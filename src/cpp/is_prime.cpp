@@ -5,15 +5,17 @@
 #include <bitset>
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cout << "usage: is_prime number." << std::endl;
+    GenerationOptions options;
+    std::vector<std::string> args = parse_generation_options(argc, argv, options);
+    if (args.size() != 1) {
+        std::cout << "usage: is_prime [options] number." << std::endl;
         return 1;
     }
     
-    std::string target_str = argv[1];
+    std::string target_str = args[0];
     
     if (!std::regex_match(target_str, std::regex("^\\d+$"))) {
-        std::cout << "usage: is_prime number." << std::endl;
+        std::cout << "usage: is_prime [options] number." << std::endl;
         return 1;
     }
     
@@ -29,35 +31,20 @@ int main(int argc, char* argv[]) {
     
     std::cout << "Target: " << target << " (bit width: " << len << ")" << std::endl;
     
-    std::vector<std::string> conditions;
+    GenerationContext context(options);
+    ConstraintDag conditions(context);
     
-    {
-        IsPrime is_prime_op("target", len, len);
-        auto is_prime_clauses = is_prime_op.expand();
-        conditions.insert(conditions.end(), is_prime_clauses.begin(), is_prime_clauses.end());
-    }
+    conditions.add<IsPrime>(context.sym("target"), len, len);
     
-    {
-        Input_Equals_Number target_constraint("target", target, len);
-        auto target_clauses = target_constraint.expand();
-        conditions.insert(conditions.end(), target_clauses.begin(), target_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("target"), target, len);
     
-    {
-        Input_Equals_Number one_constraint("One_NBit_" + Z(len), 1, len);
-        auto one_clauses = one_constraint.expand();
-        conditions.insert(conditions.end(), one_clauses.begin(), one_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("One_NBit")[len], 1, len);
     
-    {
-        Input_Equals_Number one_constraint_2x("One_NBit_" + Z(len*2), 1, len*2);
-        auto one_clauses_2x = one_constraint_2x.expand();
-        conditions.insert(conditions.end(), one_clauses_2x.begin(), one_clauses_2x.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("One_NBit")[len*2], 1, len*2);
     
-    conditions.push_back(" -<Zero_1Bit_" + Z(1) + "> 0 ");
+    conditions.add<ClauseCondition>(Clause{-var(context.sym("Zero_1Bit")[1])});
     
-    std::string filename = "is_prime_" + std::to_string(target) + ".cnf";
+    std::string filename = cnf_file_name("is_prime_" + std::to_string(target), options);
     generate_cnf(conditions, filename);
     
     std::cout << "CNF file generated: " << filename << std::endl;
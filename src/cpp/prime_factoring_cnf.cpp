@@ -5,13 +5,15 @@
 #include <bitset>
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cout << "usage: prime_factoring_cnf number." << std::endl;
+    GenerationOptions options;
+    std::vector<std::string> args = parse_generation_options(argc, argv, options);
+    if (args.size() != 1) {
+        std::cout << "usage: prime_factoring_cnf [options] number." << std::endl;
         return 1;
     }
-    std::string target_str = argv[1];
+    std::string target_str = args[0];
     if (!std::regex_match(target_str, std::regex("^\\d+$"))) {
-        std::cout << "usage: prime_factoring_cnf number." << std::endl;
+        std::cout << "usage: prime_factoring_cnf [options] number." << std::endl;
         return 1;
     }
     int target = std::stoi(target_str);
@@ -23,50 +25,29 @@ int main(int argc, char* argv[]) {
     
     std::cout << "Target: " << target << " (bit width: " << len << ")" << std::endl;
     
-    std::vector<std::string> conditions;
+    GenerationContext context(options);
+    ConstraintDag conditions(context);
     
     // Mul_NBit: factor1 * factor2 = target
-    {
-        Mul_NBit mul_nbit("factor1", "factor2", "target", "overflow", len);
-        auto mul_clauses = mul_nbit.expand();
-        conditions.insert(conditions.end(), mul_clauses.begin(), mul_clauses.end());
-    }
+    conditions.add<Mul_NBit>(context.sym("factor1"), context.sym("factor2"), context.sym("target"), context.sym("overflow"), len);
     
     // Input_Not_Equals_Number: factor1 != target
-    {
-        Input_Not_Equals_Number factor1_not_target("factor1", target, len);
-        conditions.push_back(factor1_not_target.expand());
-    }
+    conditions.add<Input_Not_Equals_Number>(context.sym("factor1"), target, len);
     
     // Input_Not_Equals_Number: factor2 != target
-    {
-        Input_Not_Equals_Number factor2_not_target("factor2", target, len);
-        conditions.push_back(factor2_not_target.expand());
-    }
+    conditions.add<Input_Not_Equals_Number>(context.sym("factor2"), target, len);
     
-    {
-        Input_Equals_Number target_constraint("target", target, len);
-        auto target_clauses = target_constraint.expand();
-        conditions.insert(conditions.end(), target_clauses.begin(), target_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("target"), target, len);
     
-    conditions.push_back("-<overflow> 0 ");
+    conditions.add<ClauseCondition>(Clause{-var(context.sym("overflow"))});
     
-    {
-        Input_Equals_Number one_constraint("One_NBit_" + Z(len), 1, len);
-        auto one_clauses = one_constraint.expand();
-        conditions.insert(conditions.end(), one_clauses.begin(), one_clauses.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("One_NBit")[len], 1, len);
     
-    {
-        Input_Equals_Number one_constraint_2x("One_NBit_" + Z(len*2), 1, len*2);
-        auto one_clauses_2x = one_constraint_2x.expand();
-        conditions.insert(conditions.end(), one_clauses_2x.begin(), one_clauses_2x.end());
-    }
+    conditions.add<Input_Equals_Number>(context.sym("One_NBit")[len*2], 1, len*2);
     
-    conditions.push_back(" -<Zero_1Bit_" + Z(1) + "> 0 ");
+    conditions.add<ClauseCondition>(Clause{-var(context.sym("Zero_1Bit")[1])});
     
-    std::string filename = "prime_factoring_" + std::to_string(target) + ".cnf";
+    std::string filename = cnf_file_name("prime_factoring_" + std::to_string(target), options);
     generate_cnf(conditions, filename);
     
     std::cout << "CNF file generated: " << filename << std::endl;
@@ -0,0 +1,54 @@
+#include "core.hpp"
+#include <iostream>
+#include <string>
+#include <charconv>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: symbol_lookup file.symbols [name|id ...]" << std::endl;
+        return 1;
+    }
+    SymbolMap symbols;
+    if (!symbols.open(argv[1])) {
+        std::cerr << "Error: Could not read symbol map " << argv[1] << std::endl;
+        return 1;
+    }
+    
+    // Without queries, list every name like the "cv" lines
+    if (argc == 2) {
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            std::cout << "cv <" << symbols.name_at(i) << "> " << symbols.id_at(i) << "\n";
+        }
+        return 0;
+    }
+    
+    int status = 0;
+    for (int i = 2; i < argc; ++i) {
+        std::string query = argv[i];
+        if (!query.empty() && query.find_first_not_of("-0123456789") == std::string::npos) {
+            // A malformed or out-of-range id is reported like any other unknown query
+            int id = 0;
+            const auto [end, error] = std::from_chars(query.data(), query.data() + query.size(), id);
+            const bool parsed = error == std::errc() && end == query.data() + query.size();
+            std::string_view name = parsed ? symbols.name(id) : std::string_view();
+            if (name.empty()) {
+                std::cout << query << ": not found" << std::endl;
+                status = 1;
+            } else {
+                std::cout << query << " <" << name << ">" << std::endl;
+            }
+        } else {
+            if (query.size() > 1 && query.front() == '<' && query.back() == '>') {
+                query = query.substr(1, query.size() - 2);
+            }
+            int id = symbols.id(query);
+            if (id == 0) {
+                std::cout << "<" << query << ">: not found" << std::endl;
+                status = 1;
+            } else {
+                std::cout << "<" << query << "> " << id << std::endl;
+            }
+        }
+    }
+    return status;
+}